@@ -159,10 +159,14 @@ namespace fw {
 
     void maybe_change_floor(WorldModel& model, Location& location)
     {
-      const MapCellDecoration decoration = model.state.map.from_floor(location.floor)(location.position).decoration;
+      const MapCellDecoration decoration = model.state.map.cell(location).decoration;
 
       switch (decoration) {
         case MapCellDecoration::FloorDown:
+          if (location.floor == Floor::Ground) {
+            model.prepare_cave(location.position);
+          }
+
           apply_change_floor(model, location, compute_floor_down(location.floor));
           break;
         case MapCellDecoration::FloorUp:
@@ -429,7 +433,7 @@ namespace fw {
 
           const AnimalElement& element = actor.data->element.from<ActorType::Animal>();
 
-          if (element.biome != model.state.map.from_floor(component.location.floor)(new_position).region) {
+          if (element.biome != model.state.map.cell({ new_position, component.location.floor }).region) {
             // the new position is not on the preferred biome of the animal
             model.update_current_task_in_queue(WanderIdleTime);
             return ActionResult::Failure;
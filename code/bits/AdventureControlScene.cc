@@ -182,9 +182,7 @@ namespace fw {
 
     const Location location = state->hero().location();
 
-    const BackgroundMap& state_map = state->map.from_floor(location.floor);
-
-    if (!state_map(target).explored()) {
+    if (!state->map.cell({ target, location.floor }).explored()) {
       m_computed_path.clear();
       return;
     }
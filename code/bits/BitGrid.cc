@@ -0,0 +1,303 @@
+#include "BitGrid.h"
+
+#include <cassert>
+
+#include <algorithm>
+
+#include "WorkerPool.h"
+
+namespace fw {
+
+  namespace {
+
+    using Word = BitGrid::Word;
+
+    constexpr int32_t BandSize = 64;
+
+    Word word_or_zero(const BitGrid& grid, int32_t x, int32_t y)
+    {
+      if (x < 0 || x >= grid.row_words() || y < 0 || y >= grid.size().h) {
+        return 0;
+      }
+
+      return grid.word(x, y);
+    }
+
+    // the neighbors of a word, shifted so that bit k is the neighbor of cell k
+
+    struct WordNeighborhood {
+      Word previous;
+      Word current;
+      Word next;
+
+      WordNeighborhood(const BitGrid& grid, int32_t x, int32_t y)
+      : previous(word_or_zero(grid, x - 1, y))
+      , current(word_or_zero(grid, x, y))
+      , next(word_or_zero(grid, x + 1, y))
+      {
+      }
+
+      Word west(int shift) const
+      {
+        return (current << shift) | (previous >> (BitGrid::WordBits - shift));
+      }
+
+      Word east(int shift) const
+      {
+        return (current >> shift) | (next << (BitGrid::WordBits - shift));
+      }
+    };
+
+    // a bit-sliced counter: bit k of the planes is the binary count for cell k
+
+    struct BitCounter {
+      Word planes[4] = { 0, 0, 0, 0 };
+
+      void add(Word input)
+      {
+        Word carry = input;
+
+        for (Word& plane : planes) {
+          const Word next_carry = plane & carry;
+          plane ^= carry;
+          carry = next_carry;
+        }
+
+        assert(carry == 0); // at most 15
+      }
+
+      Word at_least(int threshold) const
+      {
+        if (threshold <= 0) {
+          return ~Word(0);
+        }
+
+        if (threshold > 15) {
+          return 0;
+        }
+
+        // count > threshold - 1, compared from the most significant plane
+        const unsigned reference = static_cast<unsigned>(threshold - 1);
+        Word greater = 0;
+        Word equal = ~Word(0);
+
+        for (int i = 3; i >= 0; --i) {
+          if ((reference >> i) & 1) {
+            equal &= planes[i];
+          } else {
+            greater |= equal & planes[i];
+            equal &= ~planes[i];
+          }
+        }
+
+        return greater;
+      }
+    };
+
+    template<typename Function>
+    void for_each_band(int32_t height, WorkerPool& pool, Function function)
+    {
+      const std::size_t band_count = static_cast<std::size_t>((height + BandSize - 1) / BandSize);
+
+      pool.parallel_for(band_count, [&](std::size_t band) {
+        const int32_t first = static_cast<int32_t>(band) * BandSize;
+        const int32_t last = std::min(first + BandSize, height);
+
+        for (int32_t y = first; y < last; ++y) {
+          function(y);
+        }
+      });
+    }
+
+  }
+
+  /*
+   * BitGrid
+   */
+
+  BitGrid::BitGrid(gf::Vec2I size, bool value)
+  : m_size(size)
+  , m_row_words((size.w + WordBits - 1) / WordBits)
+  , m_words(static_cast<std::size_t>(m_row_words) * static_cast<std::size_t>(size.h), value ? ~Word(0) : Word(0))
+  {
+    if (value && m_row_words > 0) {
+      const Word mask = last_word_mask();
+
+      for (int32_t y = 0; y < m_size.h; ++y) {
+        word(m_row_words - 1, y) &= mask;
+      }
+    }
+  }
+
+  void BitGrid::set(gf::Vec2I position, bool value)
+  {
+    assert(valid(position));
+    const Word bit = Word(1) << (position.x % WordBits);
+    Word& target = word(position.x / WordBits, position.y);
+
+    if (value) {
+      target |= bit;
+    } else {
+      target &= ~bit;
+    }
+  }
+
+  BitGrid::Word BitGrid::last_word_mask() const
+  {
+    const int32_t remaining = m_size.w % WordBits;
+
+    if (remaining == 0) {
+      return ~Word(0);
+    }
+
+    return (Word(1) << remaining) - 1;
+  }
+
+  /*
+   * Automaton
+   */
+
+  std::vector<BitSpan> compute_row_spans(const BitGrid& active)
+  {
+    std::vector<BitSpan> spans(static_cast<std::size_t>(active.size().h));
+
+    for (int32_t y = 0; y < active.size().h; ++y) {
+      const std::span<const Word> row = active.row(y);
+      BitSpan& span = spans[y];
+
+      for (int32_t x = 0; x < active.row_words(); ++x) {
+        if (row[x] != 0) {
+          if (span.first > span.last) {
+            span.first = x;
+          }
+
+          span.last = x;
+        }
+      }
+    }
+
+    return spans;
+  }
+
+  void step_twelve_neighbors(const BitGrid& current, BitGrid& next, const BitGrid& active, const std::vector<BitSpan>& spans, BitAutomatonRule rule, WorkerPool& pool)
+  {
+    assert(current.size() == next.size() && current.size() == active.size());
+    assert(spans.size() == static_cast<std::size_t>(current.size().h));
+
+    /*
+     * +-+-+-+-+-+
+     * | | |X| | |
+     * +-+-+-+-+-+
+     * | |X|X|X| |
+     * +-+-+-+-+-+
+     * |X|X|P|X|X|
+     * +-+-+-+-+-+
+     * | |X|X|X| |
+     * +-+-+-+-+-+
+     * | | |X| | |
+     * +-+-+-+-+-+
+     */
+
+    for_each_band(current.size().h, pool, [&](int32_t y) {
+      const std::span<const Word> current_row = current.row(y);
+      std::copy(current_row.begin(), current_row.end(), &next.word(0, y));
+
+      const BitSpan span = spans[y];
+
+      for (int32_t x = span.first; x <= span.last; ++x) {
+        const Word mask = active.word(x, y);
+
+        if (mask == 0) {
+          continue;
+        }
+
+        const WordNeighborhood row_m2(current, x, y - 2);
+        const WordNeighborhood row_m1(current, x, y - 1);
+        const WordNeighborhood row_0(current, x, y);
+        const WordNeighborhood row_p1(current, x, y + 1);
+        const WordNeighborhood row_p2(current, x, y + 2);
+
+        BitCounter counter;
+        counter.add(row_m2.current);
+        counter.add(row_m1.west(1));
+        counter.add(row_m1.current);
+        counter.add(row_m1.east(1));
+        counter.add(row_0.west(2));
+        counter.add(row_0.west(1));
+        counter.add(row_0.east(1));
+        counter.add(row_0.east(2));
+        counter.add(row_p1.west(1));
+        counter.add(row_p1.current);
+        counter.add(row_p1.east(1));
+        counter.add(row_p2.current);
+
+        const Word cell = row_0.current;
+        const Word evolved = (cell & counter.at_least(rule.survival)) | (~cell & counter.at_least(rule.birth));
+        next.word(x, y) = (~mask & cell) | (mask & evolved);
+      }
+    });
+  }
+
+  void clear_isolated(BitGrid& grid, const BitGrid& active, const std::vector<BitSpan>& spans, WorkerPool& pool)
+  {
+    assert(grid.size() == active.size());
+    assert(spans.size() == static_cast<std::size_t>(grid.size().h));
+
+    // an isolated cell has no set neighbor so clearing it can not isolate
+    // another cell, the result is the same as a sequential sweep
+    const BitGrid source = grid;
+
+    for_each_band(grid.size().h, pool, [&](int32_t y) {
+      const BitSpan span = spans[y];
+
+      for (int32_t x = span.first; x <= span.last; ++x) {
+        const Word mask = active.word(x, y);
+
+        if (mask == 0) {
+          continue;
+        }
+
+        const WordNeighborhood row_0(source, x, y);
+        const Word neighbors = word_or_zero(source, x, y - 1) | row_0.west(1) | row_0.east(1) | word_or_zero(source, x, y + 1);
+        grid.word(x, y) = row_0.current & ~(mask & ~neighbors);
+      }
+    });
+  }
+
+  /*
+   * Autotiling
+   */
+
+  void add_neighbor_planes(const BitGrid& grid, BitNeighborPlanes& planes)
+  {
+    const gf::Vec2I size = planes.north.size();
+    assert(grid.size() == size + 2);
+
+    for (int32_t y = 0; y < size.h; ++y) {
+      for (int32_t x = 0; x < planes.north.row_words(); ++x) {
+        // bit k of the inner word x is the cell 64 * x + k + 1 of the grid
+        const WordNeighborhood row_0(grid, x, y + 1);
+        const Word cells = row_0.east(1);
+
+        if (cells == 0) {
+          continue;
+        }
+
+        planes.north.word(x, y) |= cells & WordNeighborhood(grid, x, y).east(1);
+        planes.east.word(x, y) |= cells & row_0.east(2);
+        planes.south.word(x, y) |= cells & WordNeighborhood(grid, x, y + 2).east(1);
+        planes.west.word(x, y) |= cells & row_0.current;
+      }
+    }
+
+    // the bits after the inner cells of the last words come from the border
+    const Word last_word_mask = planes.north.last_word_mask();
+
+    for (BitGrid* plane : { &planes.north, &planes.east, &planes.south, &planes.west }) {
+      for (int32_t y = 0; y < size.h; ++y) {
+        plane->word(plane->row_words() - 1, y) &= last_word_mask;
+      }
+    }
+  }
+
+}
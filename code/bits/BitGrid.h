@@ -0,0 +1,137 @@
+#ifndef FW_BIT_GRID_H
+#define FW_BIT_GRID_H
+
+#include <cstdint>
+
+#include <span>
+#include <vector>
+
+#include <gf2/core/Vec2.h>
+
+namespace fw {
+  class WorkerPool;
+
+  // a grid of booleans, 64 cells per word, bit k of word w is the cell at x = 64 * w + k
+
+  class BitGrid {
+  public:
+    using Word = uint64_t;
+    static constexpr int32_t WordBits = 64;
+
+    BitGrid() = default;
+    explicit BitGrid(gf::Vec2I size, bool value = false);
+
+    gf::Vec2I size() const
+    {
+      return m_size;
+    }
+
+    int32_t row_words() const
+    {
+      return m_row_words;
+    }
+
+    bool valid(gf::Vec2I position) const
+    {
+      return 0 <= position.x && position.x < m_size.w && 0 <= position.y && position.y < m_size.h;
+    }
+
+    bool test(gf::Vec2I position) const
+    {
+      return ((word(position.x / WordBits, position.y) >> (position.x % WordBits)) & 1) != 0;
+    }
+
+    void set(gf::Vec2I position, bool value = true);
+
+    Word word(int32_t x, int32_t y) const
+    {
+      return m_words[index(x, y)];
+    }
+
+    Word& word(int32_t x, int32_t y)
+    {
+      return m_words[index(x, y)];
+    }
+
+    std::span<const Word> row(int32_t y) const
+    {
+      return { m_words.data() + index(0, y), static_cast<std::size_t>(m_row_words) };
+    }
+
+    // the bits of the last word of a row that are inside the grid
+    Word last_word_mask() const;
+
+  private:
+    std::size_t index(int32_t x, int32_t y) const
+    {
+      return static_cast<std::size_t>(y) * static_cast<std::size_t>(m_row_words) + static_cast<std::size_t>(x);
+    }
+
+    gf::Vec2I m_size = { 0, 0 };
+    int32_t m_row_words = 0;
+    std::vector<Word> m_words;
+  };
+
+  // the words of a row that contain at least one active cell, empty if first > last
+  struct BitSpan {
+    int32_t first = 0;
+    int32_t last = -1;
+  };
+
+  std::vector<BitSpan> compute_row_spans(const BitGrid& active);
+
+  /*
+   * Cellular automaton on the twelve neighbors of a cell (the 5x5 diamond
+   * minus the center). Only the active cells evolve, the other cells keep
+   * their state. Cells outside the grid count as unset.
+   *
+   * A set cell stays set with at least `survival` set neighbors, an unset
+   * cell becomes set with at least `birth` set neighbors.
+   */
+
+  struct BitAutomatonRule {
+    int survival = 0;
+    int birth = 0;
+  };
+
+  void step_twelve_neighbors(const BitGrid& current, BitGrid& next, const BitGrid& active, const std::vector<BitSpan>& spans, BitAutomatonRule rule, WorkerPool& pool);
+
+  // unset the active cells that have no set cell among their four neighbors
+  void clear_isolated(BitGrid& grid, const BitGrid& active, const std::vector<BitSpan>& spans, WorkerPool& pool);
+
+  /*
+   * Autotiling of classes of cells (water, cliffs...). A class is a grid
+   * with a border of one cell around the cells of interest, the border only
+   * gives the neighbors of the inner cells. The planes have the size of the
+   * inner cells, a bit is set if the cell and its neighbor in the direction
+   * are set. The planes are computed a word at a time, and several classes
+   * can be added to the same planes as long as they do not share an inner
+   * cell.
+   */
+
+  struct BitNeighborPlanes {
+    BitGrid north;
+    BitGrid east;
+    BitGrid south;
+    BitGrid west;
+
+    explicit BitNeighborPlanes(gf::Vec2I size)
+    : north(size)
+    , east(size)
+    , south(size)
+    , west(size)
+    {
+    }
+
+    // north 0b0001, east 0b0010, south 0b0100, west 0b1000
+    uint8_t mask(gf::Vec2I position) const
+    {
+      return static_cast<uint8_t>(uint8_t(north.test(position)) | (uint8_t(east.test(position)) << 1) | (uint8_t(south.test(position)) << 2) | (uint8_t(west.test(position)) << 3));
+    }
+  };
+
+  void add_neighbor_planes(const BitGrid& grid, BitNeighborPlanes& planes);
+
+}
+
+#endif // FW_BIT_GRID_H
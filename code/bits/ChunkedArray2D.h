@@ -0,0 +1,270 @@
+#ifndef FW_CHUNKED_ARRAY_2D_H
+#define FW_CHUNKED_ARRAY_2D_H
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#include <array>
+#include <initializer_list>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <vector>
+
+#include <gf2/core/Range.h>
+#include <gf2/core/Rect.h>
+#include <gf2/core/TypeTraits.h>
+#include <gf2/core/Vec2.h>
+
+#include "Settings.h"
+
+namespace fw {
+
+  /*
+   * A 2D array made of square chunks that are allocated when they are
+   * written.
+   *
+   * At the beginning, all the chunks share a single chunk filled with the
+   * same value. A chunk is copied the first time one of its cells is accessed
+   * through a non-const reference, so the const accessors must be used for
+   * reading. The chunks are also shared between the copies of the array.
+   */
+
+  template<typename T>
+  class ChunkedArray2D {
+  public:
+    static constexpr int32_t ChunkSize = MapChunkSize;
+
+    ChunkedArray2D() = default;
+
+    ChunkedArray2D(gf::Vec2I size, const T& value)
+    : m_size(size)
+    , m_chunk_count((size.w + ChunkSize - 1) / ChunkSize, (size.h + ChunkSize - 1) / ChunkSize)
+    , m_fill(std::make_shared<Chunk>())
+    {
+      m_fill->fill(value);
+      m_chunks.assign(static_cast<std::size_t>(m_chunk_count.w) * static_cast<std::size_t>(m_chunk_count.h), m_fill);
+    }
+
+    gf::Vec2I size() const
+    {
+      return m_size;
+    }
+
+    bool valid(gf::Vec2I position) const
+    {
+      return 0 <= position.x && position.x < m_size.w && 0 <= position.y && position.y < m_size.h;
+    }
+
+    auto position_range() const
+    {
+      return gf::position_range(m_size);
+    }
+
+    const T& operator()(gf::Vec2I position) const
+    {
+      assert(valid(position));
+      return (*m_chunks[chunk_index(position)])[cell_index(position)];
+    }
+
+    T& operator()(gf::Vec2I position)
+    {
+      assert(valid(position));
+      return own_chunk(chunk_index(position))[cell_index(position)];
+    }
+
+    std::vector<gf::Vec2I> compute_4_neighbors_range(gf::Vec2I position) const
+    {
+      return compute_neighbors(position, { gf::vec(0, -1), gf::vec(1, 0), gf::vec(0, 1), gf::vec(-1, 0) });
+    }
+
+    std::vector<gf::Vec2I> compute_8_neighbors_range(gf::Vec2I position) const
+    {
+      return compute_neighbors(position, { gf::vec(-1, -1), gf::vec(0, -1), gf::vec(1, -1), gf::vec(1, 0), gf::vec(1, 1), gf::vec(0, 1), gf::vec(-1, 1), gf::vec(-1, 0) });
+    }
+
+    const T& fill_value() const
+    {
+      assert(m_fill);
+      return (*m_fill)[0];
+    }
+
+    // the chunks are the same as the chunks of MapChunks
+    bool chunk_filled(gf::Vec2I chunk) const
+    {
+      return m_chunks[static_cast<std::size_t>(chunk.x) + static_cast<std::size_t>(chunk.y) * static_cast<std::size_t>(m_chunk_count.w)] == m_fill;
+    }
+
+    // true if writing a cell of the area or one of the allocated cells copies a chunk (see own_chunk())
+    bool shares_chunks(gf::RectI area) const
+    {
+      for (const std::shared_ptr<Chunk>& chunk : m_chunks) {
+        if (chunk != m_fill && chunk.use_count() > 1) {
+          return true;
+        }
+      }
+
+      bool shared = false;
+
+      for_each_chunk_index(area, [&](std::size_t index) {
+        shared = shared || m_chunks[index] == m_fill;
+      });
+
+      return shared;
+    }
+
+    // the chunks are copied now so that the next writes in the area do not change the chunks
+    void own_chunks(gf::RectI area)
+    {
+      for_each_chunk_index(area, [this](std::size_t index) {
+        own_chunk(index);
+      });
+    }
+
+    // same for the allocated chunks that are shared with a copy of the array
+    void own_allocated_chunks()
+    {
+      for (std::size_t index = 0; index < m_chunks.size(); ++index) {
+        if (m_chunks[index] != m_fill) {
+          own_chunk(index);
+        }
+      }
+    }
+
+    std::size_t allocated_chunk_count() const
+    {
+      std::size_t count = 0;
+
+      for (const std::shared_ptr<Chunk>& chunk : m_chunks) {
+        if (chunk != m_fill) {
+          ++count;
+        }
+      }
+
+      return count;
+    }
+
+    // the cells that are not in the fill chunk
+    template<typename Function>
+    void for_each_allocated_cell(Function function)
+    {
+      for (std::size_t index = 0; index < m_chunks.size(); ++index) {
+        if (m_chunks[index] == m_fill) {
+          continue;
+        }
+
+        for (T& cell : own_chunk(index)) {
+          function(cell);
+        }
+      }
+    }
+
+    template<typename Archive>
+    friend Archive& operator|(Archive& ar, gf::MaybeConst<ChunkedArray2D, Archive>& array)
+    {
+      // only the chunks that are not the fill chunk are saved
+      if constexpr (std::is_const_v<gf::MaybeConst<ChunkedArray2D, Archive>>) {
+        assert(array.m_fill);
+        ar | array.m_size | (*array.m_fill)[0];
+
+        for (const std::shared_ptr<Chunk>& chunk : array.m_chunks) {
+          const bool allocated = chunk != array.m_fill;
+          ar | allocated;
+
+          if (allocated) {
+            for (const T& cell : *chunk) {
+              ar | cell;
+            }
+          }
+        }
+      } else {
+        gf::Vec2I size = { 0, 0 };
+        T value = {};
+        ar | size | value;
+
+        array = ChunkedArray2D(size, value);
+
+        for (std::shared_ptr<Chunk>& chunk : array.m_chunks) {
+          bool allocated = false;
+          ar | allocated;
+
+          if (allocated) {
+            chunk = std::make_shared<Chunk>();
+
+            for (T& cell : *chunk) {
+              ar | cell;
+            }
+          }
+        }
+      }
+
+      return ar;
+    }
+
+  private:
+    using Chunk = std::array<T, ChunkSize * ChunkSize>;
+
+    std::size_t chunk_index(gf::Vec2I position) const
+    {
+      return static_cast<std::size_t>(position.x / ChunkSize) + static_cast<std::size_t>(position.y / ChunkSize) * static_cast<std::size_t>(m_chunk_count.w);
+    }
+
+    static std::size_t cell_index(gf::Vec2I position)
+    {
+      return static_cast<std::size_t>(position.x % ChunkSize) + static_cast<std::size_t>(position.y % ChunkSize) * ChunkSize;
+    }
+
+    Chunk& own_chunk(std::size_t index)
+    {
+      std::shared_ptr<Chunk>& chunk = m_chunks[index];
+
+      // the fill chunk is always shared with m_fill
+      if (chunk.use_count() > 1) {
+        chunk = std::make_shared<Chunk>(*chunk);
+      }
+
+      return *chunk;
+    }
+
+    template<typename Function>
+    void for_each_chunk_index(gf::RectI area, Function function) const
+    {
+      const std::optional<gf::RectI> clipped = gf::RectI::from_size(m_size).intersection(area);
+
+      if (!clipped) {
+        return;
+      }
+
+      const gf::Vec2I min = clipped->position() / ChunkSize;
+      const gf::Vec2I max = (clipped->position() + clipped->size() - 1) / ChunkSize;
+
+      for (int32_t y = min.y; y <= max.y; ++y) {
+        for (int32_t x = min.x; x <= max.x; ++x) {
+          function(static_cast<std::size_t>(x) + static_cast<std::size_t>(y) * static_cast<std::size_t>(m_chunk_count.w));
+        }
+      }
+    }
+
+    std::vector<gf::Vec2I> compute_neighbors(gf::Vec2I position, std::initializer_list<gf::Vec2I> offsets) const
+    {
+      std::vector<gf::Vec2I> neighbors;
+
+      for (const gf::Vec2I offset : offsets) {
+        if (const gf::Vec2I neighbor = position + offset; valid(neighbor)) {
+          neighbors.push_back(neighbor);
+        }
+      }
+
+      return neighbors;
+    }
+
+    gf::Vec2I m_size = { 0, 0 };
+    gf::Vec2I m_chunk_count = { 0, 0 };
+    std::shared_ptr<Chunk> m_fill;
+    std::vector<std::shared_ptr<Chunk>> m_chunks;
+  };
+
+}
+
+#endif // FW_CHUNKED_ARRAY_2D_H
@@ -57,11 +57,11 @@ namespace fw {
   void ContextualConsoleEntity::update_scanning()
   {
     const WorldState* state = m_game->state();
-    const WorldRuntime* runtime = m_game->runtime();
+    WorldRuntime* runtime = m_game->runtime();
     const Location location = state->hero().location();
     const gf::RectI view_zone = gf::RectI::from_center_size(location.position, { 2 * HeroVisionRange, 2 * HeroVisionRange });
     const Floor floor = location.floor;
-    const BackgroundMap& background_map = state->map.from_floor(floor);
+    runtime->map.bind_view(floor, view_zone);
     const FloorMap& floor_map = runtime->map.from_floor(floor);
 
     // actors
@@ -69,7 +69,7 @@ namespace fw {
     m_actors.clear();
 
     for (const gf::Vec2I position : gf::rectangle_range(view_zone)) {
-      if (!background_map(position).visible()) {
+      if (!state->map.cell({ position, floor }).visible()) {
         continue;
       }
 
@@ -87,7 +87,7 @@ namespace fw {
           .picture = display.picture,
           .name = actor.data->label.tag,
           .foreground = display.color,
-          .background = floor_map.console(position).parts[0].background,
+          .background = floor_map.background_color(position),
           .position = position,
           .distance = static_cast<int32_t>(gf::euclidean_distance(location.position, position))
         };
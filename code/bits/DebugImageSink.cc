@@ -0,0 +1,78 @@
+#include "DebugImageSink.h"
+
+#include <cstdlib>
+
+#include <optional>
+#include <system_error>
+
+#include <gf2/core/Clock.h>
+#include <gf2/core/Log.h>
+
+namespace fw {
+
+  DebugImageSink::DebugImageSink(std::filesystem::path directory)
+  : m_directory(std::move(directory))
+  {
+    if (!enabled()) {
+      return;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(m_directory, error);
+
+    if (error) {
+      gf::Log::warning("Could not create the debug image directory {}: {}", m_directory.string(), error.message());
+    }
+
+    m_thread = std::jthread([this](std::stop_token token) { run(token); });
+  }
+
+  void DebugImageSink::push(std::string filename, gf::Image image)
+  {
+    {
+      std::unique_lock lock(m_mutex);
+      // the images are big, do not keep too many of them in memory
+      m_condition.wait(lock, [this]() { return m_jobs.size() < MaxPendingImages; });
+      m_jobs.push_back({ std::move(filename), std::move(image) });
+    }
+
+    m_condition.notify_all();
+  }
+
+  void DebugImageSink::run(std::stop_token token)
+  {
+    for (;;) {
+      std::optional<Job> job;
+
+      {
+        std::unique_lock lock(m_mutex);
+        m_condition.wait(lock, token, [this]() { return !m_jobs.empty(); });
+
+        // when stopped, the pending images are still written
+        if (m_jobs.empty()) {
+          return;
+        }
+
+        job.emplace(std::move(m_jobs.front()));
+        m_jobs.pop_front();
+      }
+
+      m_condition.notify_all();
+
+      gf::Clock clock;
+      const std::filesystem::path path = m_directory / job->filename;
+      job->image.save_to_file(path);
+      gf::Log::debug("Debug image {} written in {:g}s", path.string(), clock.elapsed_time().as_seconds());
+    }
+  }
+
+  std::filesystem::path compute_debug_images_directory()
+  {
+    if (const char* variable = std::getenv("FARWESTRL_DEBUG_IMAGES"); variable != nullptr) {
+      return variable;
+    }
+
+    return {};
+  }
+
+}
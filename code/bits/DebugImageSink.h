@@ -0,0 +1,73 @@
+#ifndef FW_DEBUG_IMAGE_SINK_H
+#define FW_DEBUG_IMAGE_SINK_H
+
+#include <cstddef>
+
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <gf2/core/Image.h>
+
+namespace fw {
+
+  /*
+   * A sink for the debug images of the generation.
+   *
+   * The images are encoded and written by a background thread, so the
+   * generation only pays for computing them. When the sink is disabled, the
+   * images are not even computed.
+   */
+
+  class DebugImageSink {
+  public:
+    static constexpr std::size_t MaxPendingImages = 4;
+
+    // disabled if the directory is empty
+    explicit DebugImageSink(std::filesystem::path directory);
+    DebugImageSink(const DebugImageSink&) = delete;
+    DebugImageSink(DebugImageSink&&) = delete;
+    ~DebugImageSink() = default; // the pending images are written before
+
+    DebugImageSink& operator=(const DebugImageSink&) = delete;
+    DebugImageSink& operator=(DebugImageSink&&) = delete;
+
+    bool enabled() const
+    {
+      return !m_directory.empty();
+    }
+
+    // compute_image() is called only if the sink is enabled
+    template<typename Function>
+    void submit(std::string filename, Function compute_image)
+    {
+      if (enabled()) {
+        push(std::move(filename), compute_image());
+      }
+    }
+
+  private:
+    struct Job {
+      std::string filename;
+      gf::Image image;
+    };
+
+    void push(std::string filename, gf::Image image);
+    void run(std::stop_token token);
+
+    std::filesystem::path m_directory;
+    std::mutex m_mutex;
+    std::condition_variable_any m_condition;
+    std::deque<Job> m_jobs;
+    std::jthread m_thread; // last, so that it is stopped first
+  };
+
+  // the directory in FARWESTRL_DEBUG_IMAGES, empty if not set
+  std::filesystem::path compute_debug_images_directory();
+
+}
+
+#endif // FW_DEBUG_IMAGE_SINK_H
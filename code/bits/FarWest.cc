@@ -9,6 +9,7 @@
 #include <gf2/core/Time.h>
 
 #include "FarWestScene.h"
+#include "RandomStreams.h"
 #include "Settings.h"
 #include "WorldGeneration.h"
 #include "WorldGenerationStep.h"
@@ -31,10 +32,15 @@ namespace fw {
   , m_random(random)
   , m_datafile(datafile)
   , m_savefile(savefile)
+  , m_cache(savefile.parent_path() / "cache")
+  , m_pregeneration(&m_cache, datafile)
   , m_model(random)
   {
     push_scene(&kickoff_title);
     push_scene(&kickoff_menu);
+
+    // the next world is generated while the player reads the menu
+    m_pregeneration.start(generate_seed(m_random));
   }
 
   void FarWest::create_world(AdventureChoice choice)
@@ -43,6 +49,9 @@ namespace fw {
     m_analysis.set_step(WorldGenerationStep::Start);
 
     m_async_world = std::async(std::launch::async, [&,choice]() {
+      // the map of the previous world may still be binding in the background
+      m_model.runtime.map.stop_binding();
+
       m_analysis.set_step(WorldGenerationStep::File);
       m_model.data.load_from_file(m_datafile);
 
@@ -52,8 +61,25 @@ namespace fw {
           std::filesystem::remove(m_savefile);
         }
 
-        m_model.state = generate_world(m_random, m_model.data, m_analysis);
+        m_analysis.set_step(WorldGenerationStep::Load);
+
+        if (m_pregeneration.pending()) {
+          m_model.state = m_pregeneration.take(m_analysis);
+        } else {
+          const uint64_t seed = generate_seed(m_random);
+          const uint64_t key = WorldCache::compute_key(seed, m_datafile);
+
+          if (!m_cache.load(key, m_model.state)) {
+            m_model.state = generate_world(seed, m_model.data, m_analysis);
+            m_async_cache = m_cache.store_copy(key, m_model.state);
+          }
+        }
       } else {
+        if (m_pregeneration.pending()) {
+          // not needed now, but maybe for the next adventure
+          m_pregeneration.release();
+        }
+
         assert(has_save());
         gf::Clock clock;
         m_analysis.set_step(WorldGenerationStep::Load);
@@ -20,8 +20,10 @@
 #include "KickoffCreationScene.h"
 #include "KickoffMenuScene.h"
 #include "KickoffTitleScene.h"
+#include "WorldCache.h"
 #include "WorldModel.h"
 #include "WorldGenerationStep.h"
+#include "WorldPregeneration.h"
 
 namespace fw {
   class FarWestScene;
@@ -88,6 +90,10 @@ namespace fw {
     std::future<void> m_async_save;
     bool m_async_save_finished = false;
 
+    WorldCache m_cache;
+    std::future<void> m_async_cache;
+    WorldPregeneration m_pregeneration;
+
     WorldModel m_model;
     std::future<void> m_async_world;
     bool m_async_world_finished = false;
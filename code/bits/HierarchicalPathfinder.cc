@@ -0,0 +1,577 @@
+#include "HierarchicalPathfinder.h"
+
+#include <cassert>
+
+#include <algorithm>
+#include <limits>
+#include <queue>
+#include <tuple>
+
+#include <gf2/core/Log.h>
+
+#include "WorkerPool.h"
+
+namespace fw {
+
+  namespace {
+
+    constexpr float Infinity = std::numeric_limits<float>::infinity();
+
+    // entrances shorter than this get one portal in the middle, the others get one portal at each end
+    constexpr int32_t LongEntranceLength = 6;
+
+    constexpr gf::Vec2I FourNeighbors[] = {
+      { 0, -1 }, { -1, 0 }, { +1, 0 }, { 0, +1 }
+    };
+
+    struct QueueItem {
+      float priority;
+      int32_t index;
+
+      bool operator>(const QueueItem& other) const
+      {
+        return priority > other.priority;
+      }
+    };
+
+    template<typename T>
+    using MinQueue = std::priority_queue<T, std::vector<T>, std::greater<T>>;
+
+    bool position_less(gf::Vec2I lhs, gf::Vec2I rhs)
+    {
+      return std::tie(lhs.y, lhs.x) < std::tie(rhs.y, rhs.x);
+    }
+
+    int32_t local_index(gf::RectI area, gf::Vec2I position)
+    {
+      const gf::Vec2I local = position - area.position();
+      return local.y * area.size().w + local.x;
+    }
+
+    gf::Vec2I local_position(gf::RectI area, int32_t index)
+    {
+      return area.position() + gf::Vec2I(index % area.size().w, index / area.size().w);
+    }
+
+    void append_segment(std::vector<gf::Vec2I>& route, const std::vector<gf::Vec2I>& segment)
+    {
+      auto iterator = segment.begin();
+
+      if (!route.empty() && iterator != segment.end() && *iterator == route.back()) {
+        ++iterator;
+      }
+
+      route.insert(route.end(), iterator, segment.end());
+    }
+
+  }
+
+  HierarchicalPathfinder::HierarchicalPathfinder(const gf::GridMap& grid, DistanceFunction distance_function, WorkerPool& pool, int32_t cluster_size)
+  : m_walkable(grid.size())
+  , m_distance_function(std::move(distance_function))
+  , m_pool(&pool)
+  , m_cluster_size(cluster_size)
+  , m_cluster_count((grid.size() + cluster_size - 1) / cluster_size)
+  {
+    assert(cluster_size > 0);
+
+    for (const gf::Vec2I position : grid.position_range()) {
+      m_walkable.set(position, grid.walkable(position));
+    }
+
+    for (int32_t y = 0; y < m_cluster_count.h; ++y) {
+      for (int32_t x = 0; x < m_cluster_count.w; ++x) {
+        const gf::Vec2I min = gf::Vec2I(x, y) * cluster_size;
+        const gf::Vec2I max = { std::min(min.x + cluster_size, grid.size().w), std::min(min.y + cluster_size, grid.size().h) };
+
+        Cluster cluster;
+        cluster.area = gf::RectI::from_min_max(min, max);
+        m_clusters.push_back(std::move(cluster));
+      }
+    }
+  }
+
+  void HierarchicalPathfinder::set_walkable(gf::Vec2I position, bool walkable)
+  {
+    if (!m_walkable.valid(position) || m_walkable.test(position) == walkable) {
+      return;
+    }
+
+    m_walkable.set(position, walkable);
+    m_clusters[cluster_index(position)].dirty = true;
+    m_dirty = true;
+  }
+
+  std::vector<gf::Vec2I> HierarchicalPathfinder::compute_route(gf::Vec2I origin, gf::Vec2I target)
+  {
+    std::vector<std::vector<gf::Vec2I>> routes = compute_routes(origin, { &target, 1 });
+    return std::move(routes.front());
+  }
+
+  std::vector<std::vector<gf::Vec2I>> HierarchicalPathfinder::compute_routes(gf::Vec2I origin, std::span<const gf::Vec2I> targets)
+  {
+    std::vector<std::vector<gf::Vec2I>> routes(targets.size());
+
+    if (!m_walkable.valid(origin)) {
+      return routes;
+    }
+
+    update_graph();
+
+    // connect the targets to the portals of their clusters
+
+    struct GoalEntry {
+      std::size_t cluster;
+      AreaSearch search;
+    };
+
+    std::vector<GoalEntry> goals;
+    std::unordered_multimap<std::size_t, std::size_t> cluster_goals;
+
+    for (const gf::Vec2I target : targets) {
+      if (!m_walkable.valid(target) || !m_walkable.test(target)) {
+        goals.push_back({ cluster_index(origin), {} }); // unreachable
+        continue;
+      }
+
+      const std::size_t index = cluster_index(target);
+      cluster_goals.emplace(index, goals.size());
+      goals.push_back({ index, search_area(m_clusters[index].area, target, SearchDirection::Backward) });
+    }
+
+    // connect the origin to the portals of its cluster
+
+    struct StartEntry {
+      std::size_t cluster;
+      float offset;
+      AreaSearch search;
+    };
+
+    std::vector<StartEntry> entries;
+    entries.push_back({ cluster_index(origin), 0.0f, search_area(m_clusters[cluster_index(origin)].area, origin, SearchDirection::Forward) });
+
+    if (!m_walkable.test(origin)) {
+      // the origin is not on any entrance, its first step may leave its cluster
+      for (const gf::Vec2I relative_neighbor : FourNeighbors) {
+        const gf::Vec2I neighbor = origin + relative_neighbor;
+
+        if (m_walkable.valid(neighbor) && m_walkable.test(neighbor) && cluster_index(neighbor) != entries.front().cluster) {
+          entries.push_back({ cluster_index(neighbor), m_distance_function(origin, neighbor), search_area(m_clusters[cluster_index(neighbor)].area, neighbor, SearchDirection::Forward) });
+        }
+      }
+    }
+
+    // search in the abstract graph, the nodes after the portals are the start and the goals
+
+    const uint32_t node_count = static_cast<uint32_t>(m_node_clusters.size());
+    const uint32_t start_node = node_count;
+    const uint32_t first_goal_node = node_count + 1;
+    const uint32_t total_node_count = first_goal_node + static_cast<uint32_t>(targets.size());
+
+    auto node_position = [&](uint32_t node) {
+      if (node == start_node) {
+        return origin;
+      }
+
+      if (node >= first_goal_node) {
+        return targets[node - first_goal_node];
+      }
+
+      const Cluster& cluster = m_clusters[m_node_clusters[node]];
+      return cluster.portals[node - cluster.first_node];
+    };
+
+    // the minimum of consistent heuristics is consistent, so every goal is reached with its best cost
+    auto heuristic = [&](uint32_t node) {
+      const gf::Vec2I position = node_position(node);
+      int32_t distance = std::numeric_limits<int32_t>::max();
+
+      for (const gf::Vec2I target : targets) {
+        distance = std::min(distance, gf::manhattan_distance(position, target));
+      }
+
+      return static_cast<float>(distance);
+    };
+
+    std::vector<float> costs(total_node_count, Infinity);
+    std::vector<uint32_t> parents(total_node_count, start_node);
+    std::unordered_map<uint32_t, std::size_t> node_entries;
+    MinQueue<QueueItem> queue;
+
+    auto relax = [&](uint32_t from, uint32_t to, float cost) {
+      const float new_cost = costs[from] + cost;
+
+      if (new_cost < costs[to]) {
+        costs[to] = new_cost;
+        parents[to] = from;
+        queue.push({ new_cost + heuristic(to), static_cast<int32_t>(to) });
+        return true;
+      }
+
+      return false;
+    };
+
+    std::size_t remaining_goals = cluster_goals.size();
+
+    costs[start_node] = 0.0f;
+    queue.push({ heuristic(start_node), static_cast<int32_t>(start_node) });
+
+    while (!queue.empty() && remaining_goals > 0) {
+      const QueueItem item = queue.top();
+      queue.pop();
+
+      const uint32_t node = static_cast<uint32_t>(item.index);
+
+      if (item.priority > costs[node] + heuristic(node)) {
+        continue; // outdated
+      }
+
+      if (node >= first_goal_node) {
+        --remaining_goals;
+        continue;
+      }
+
+      if (node == start_node) {
+        for (std::size_t k = 0; k < entries.size(); ++k) {
+          const StartEntry& entry = entries[k];
+          const Cluster& cluster = m_clusters[entry.cluster];
+
+          for (std::size_t i = 0; i < cluster.portals.size(); ++i) {
+            if (const float cost = entry.search.costs[local_index(cluster.area, cluster.portals[i])]; cost < Infinity) {
+              if (const uint32_t portal = cluster.first_node + static_cast<uint32_t>(i); relax(node, portal, entry.offset + cost)) {
+                node_entries[portal] = k;
+              }
+            }
+          }
+
+          // a target in the same cluster, the backward search gives the cost from the origin
+          auto [ begin, end ] = cluster_goals.equal_range(entry.cluster);
+
+          for (auto iterator = begin; iterator != end; ++iterator) {
+            const gf::Vec2I target = targets[iterator->second];
+
+            if (const float cost = entry.search.costs[local_index(cluster.area, target)]; cost < Infinity) {
+              if (const uint32_t goal_node = first_goal_node + static_cast<uint32_t>(iterator->second); relax(node, goal_node, entry.offset + cost)) {
+                node_entries[goal_node] = k;
+              }
+            }
+          }
+        }
+
+        continue;
+      }
+
+      const std::size_t index = m_node_clusters[node];
+      const Cluster& cluster = m_clusters[index];
+      const std::size_t portal = node - cluster.first_node;
+      const std::size_t portal_count = cluster.portals.size();
+
+      for (std::size_t i = 0; i < portal_count; ++i) {
+        if (const float cost = cluster.costs[portal * portal_count + i]; i != portal && cost < Infinity) {
+          relax(node, cluster.first_node + static_cast<uint32_t>(i), cost);
+        }
+      }
+
+      for (const Link& link : m_node_links[node]) {
+        relax(node, link.node, link.cost);
+      }
+
+      auto [ begin, end ] = cluster_goals.equal_range(index);
+
+      for (auto iterator = begin; iterator != end; ++iterator) {
+        const AreaSearch& search = goals[iterator->second].search;
+
+        if (const float cost = search.costs[local_index(search.area, cluster.portals[portal])]; cost < Infinity) {
+          relax(node, first_goal_node + static_cast<uint32_t>(iterator->second), cost);
+        }
+      }
+    }
+
+    // refine the routes
+
+    for (std::size_t k = 0; k < targets.size(); ++k) {
+      const uint32_t goal_node = first_goal_node + static_cast<uint32_t>(k);
+
+      if (costs[goal_node] == Infinity) {
+        continue;
+      }
+
+      std::vector<uint32_t> abstract_route;
+
+      for (uint32_t node = goal_node; node != start_node; node = parents[node]) {
+        abstract_route.push_back(node);
+      }
+
+      abstract_route.push_back(start_node);
+      std::reverse(abstract_route.begin(), abstract_route.end());
+
+      std::vector<gf::Vec2I>& route = routes[k];
+
+      for (std::size_t i = 0; i + 1 < abstract_route.size(); ++i) {
+        const uint32_t from = abstract_route[i];
+        const uint32_t to = abstract_route[i + 1];
+
+        if (from == start_node) {
+          const std::size_t entry_index = node_entries.at(to);
+          const StartEntry& entry = entries[entry_index];
+          const gf::RectI area = entry.search.area;
+          std::vector<gf::Vec2I> segment;
+
+          for (int32_t cell = local_index(area, node_position(to)); cell != -1; cell = entry.search.links[cell]) {
+            segment.push_back(local_position(area, cell));
+          }
+
+          if (entry_index > 0) {
+            segment.push_back(origin);
+          }
+
+          std::reverse(segment.begin(), segment.end());
+          append_segment(route, segment);
+        } else if (to >= first_goal_node) {
+          const AreaSearch& search = goals[to - first_goal_node].search;
+          std::vector<gf::Vec2I> segment;
+
+          for (int32_t cell = local_index(search.area, node_position(from)); cell != -1; cell = search.links[cell]) {
+            segment.push_back(local_position(search.area, cell));
+          }
+
+          append_segment(route, segment);
+        } else if (m_node_clusters[from] == m_node_clusters[to]) {
+          Cluster& cluster = m_clusters[m_node_clusters[from]];
+          append_segment(route, refine_segment(cluster, from - cluster.first_node, to - cluster.first_node));
+        } else {
+          assert(gf::manhattan_distance(node_position(from), node_position(to)) == 1);
+          append_segment(route, { node_position(from), node_position(to) });
+        }
+      }
+
+      assert(!route.empty() && route.front() == origin && route.back() == targets[k]);
+    }
+
+    return routes;
+  }
+
+  std::size_t HierarchicalPathfinder::cluster_index(gf::Vec2I position) const
+  {
+    const gf::Vec2I cluster = position / m_cluster_size;
+    return static_cast<std::size_t>(cluster.y) * static_cast<std::size_t>(m_cluster_count.w) + static_cast<std::size_t>(cluster.x);
+  }
+
+  uint32_t HierarchicalPathfinder::portal_node(gf::Vec2I position) const
+  {
+    const Cluster& cluster = m_clusters[cluster_index(position)];
+    auto iterator = std::lower_bound(cluster.portals.begin(), cluster.portals.end(), position, position_less);
+    assert(iterator != cluster.portals.end() && *iterator == position);
+    return cluster.first_node + static_cast<uint32_t>(std::distance(cluster.portals.begin(), iterator));
+  }
+
+  void HierarchicalPathfinder::update_graph()
+  {
+    if (!m_dirty) {
+      return;
+    }
+
+    const std::vector<std::pair<gf::Vec2I, gf::Vec2I>> transitions = compute_transitions();
+
+    // portals, a cluster must be recomputed if its portals changed
+
+    std::vector<std::vector<gf::Vec2I>> portals(m_clusters.size());
+
+    for (const auto& [ lhs, rhs ] : transitions) {
+      portals[cluster_index(lhs)].push_back(lhs);
+      portals[cluster_index(rhs)].push_back(rhs);
+    }
+
+    std::vector<std::size_t> dirty_clusters;
+
+    for (std::size_t i = 0; i < m_clusters.size(); ++i) {
+      std::vector<gf::Vec2I>& cluster_portals = portals[i];
+      std::sort(cluster_portals.begin(), cluster_portals.end(), position_less);
+      cluster_portals.erase(std::unique(cluster_portals.begin(), cluster_portals.end()), cluster_portals.end());
+
+      Cluster& cluster = m_clusters[i];
+
+      if (cluster.portals != cluster_portals) {
+        cluster.portals = std::move(cluster_portals);
+        cluster.dirty = true;
+      }
+
+      if (cluster.dirty) {
+        dirty_clusters.push_back(i);
+      }
+    }
+
+    m_pool->parallel_for(dirty_clusters.size(), [&](std::size_t i) {
+      compute_cluster_costs(m_clusters[dirty_clusters[i]]);
+    });
+
+    // nodes and links between clusters
+
+    uint32_t node_count = 0;
+    m_node_clusters.clear();
+
+    for (std::size_t i = 0; i < m_clusters.size(); ++i) {
+      Cluster& cluster = m_clusters[i];
+      cluster.first_node = node_count;
+      node_count += static_cast<uint32_t>(cluster.portals.size());
+      m_node_clusters.insert(m_node_clusters.end(), cluster.portals.size(), static_cast<uint32_t>(i));
+    }
+
+    m_node_links.assign(node_count, {});
+
+    for (const auto& [ lhs, rhs ] : transitions) {
+      const uint32_t lhs_node = portal_node(lhs);
+      const uint32_t rhs_node = portal_node(rhs);
+      m_node_links[lhs_node].push_back({ rhs_node, m_distance_function(lhs, rhs) });
+      m_node_links[rhs_node].push_back({ lhs_node, m_distance_function(rhs, lhs) });
+    }
+
+    gf::Log::debug("\tAbstract graph: {} nodes, {} transitions, {} clusters computed", node_count, transitions.size(), dirty_clusters.size());
+    m_dirty = false;
+  }
+
+  std::vector<std::pair<gf::Vec2I, gf::Vec2I>> HierarchicalPathfinder::compute_transitions() const
+  {
+    std::vector<std::pair<gf::Vec2I, gf::Vec2I>> transitions;
+
+    // a run of walkable pairs along a border, cut at the cluster corners
+    auto add_runs = [&](int32_t length, auto make_pair) {
+      int32_t start = -1;
+
+      for (int32_t i = 0; i <= length; ++i) {
+        bool open = false;
+
+        if (i < length) {
+          const auto [ lhs, rhs ] = make_pair(i);
+          open = m_walkable.test(lhs) && m_walkable.test(rhs);
+        }
+
+        if (start >= 0 && (!open || i % m_cluster_size == 0)) {
+          const int32_t run = i - start;
+
+          if (run < LongEntranceLength) {
+            transitions.push_back(make_pair(start + run / 2));
+          } else {
+            transitions.push_back(make_pair(start));
+            transitions.push_back(make_pair(i - 1));
+          }
+
+          start = -1;
+        }
+
+        if (open && start < 0) {
+          start = i;
+        }
+      }
+    };
+
+    const gf::Vec2I size = m_walkable.size();
+
+    for (int32_t x = m_cluster_size; x < size.w; x += m_cluster_size) {
+      add_runs(size.h, [x](int32_t y) { return std::pair(gf::Vec2I(x - 1, y), gf::Vec2I(x, y)); });
+    }
+
+    for (int32_t y = m_cluster_size; y < size.h; y += m_cluster_size) {
+      add_runs(size.w, [y](int32_t x) { return std::pair(gf::Vec2I(x, y - 1), gf::Vec2I(x, y)); });
+    }
+
+    return transitions;
+  }
+
+  void HierarchicalPathfinder::compute_cluster_costs(Cluster& cluster) const
+  {
+    const std::size_t portal_count = cluster.portals.size();
+    cluster.costs.assign(portal_count * portal_count, Infinity);
+    cluster.segments.clear();
+
+    for (std::size_t i = 0; i < portal_count; ++i) {
+      const AreaSearch search = search_area(cluster.area, cluster.portals[i], SearchDirection::Forward);
+
+      for (std::size_t j = 0; j < portal_count; ++j) {
+        cluster.costs[i * portal_count + j] = search.costs[local_index(cluster.area, cluster.portals[j])];
+      }
+    }
+
+    cluster.dirty = false;
+  }
+
+  auto HierarchicalPathfinder::search_area(gf::RectI area, gf::Vec2I source, SearchDirection direction, std::optional<gf::Vec2I> goal) const -> AreaSearch
+  {
+    assert(area.contains(source));
+
+    AreaSearch search;
+    search.area = area;
+
+    const std::size_t cell_count = static_cast<std::size_t>(area.size().w) * static_cast<std::size_t>(area.size().h);
+    search.costs.resize(cell_count, Infinity);
+    search.links.resize(cell_count, -1);
+
+    auto heuristic = [&](gf::Vec2I position) {
+      return goal ? static_cast<float>(gf::manhattan_distance(position, *goal)) : 0.0f;
+    };
+
+    MinQueue<QueueItem> queue;
+
+    const int32_t source_index = local_index(area, source);
+    search.costs[source_index] = 0.0f;
+    queue.push({ heuristic(source), source_index });
+
+    while (!queue.empty()) {
+      const QueueItem item = queue.top();
+      queue.pop();
+
+      const gf::Vec2I position = local_position(area, item.index);
+      const float cost = search.costs[item.index];
+
+      if (item.priority > cost + heuristic(position)) {
+        continue; // outdated
+      }
+
+      if (goal && position == *goal) {
+        break;
+      }
+
+      for (const gf::Vec2I relative_neighbor : FourNeighbors) {
+        const gf::Vec2I neighbor = position + relative_neighbor;
+
+        if (!area.contains(neighbor) || !m_walkable.test(neighbor)) {
+          continue;
+        }
+
+        const float step = direction == SearchDirection::Forward ? m_distance_function(position, neighbor) : m_distance_function(neighbor, position);
+        const int32_t neighbor_index = local_index(area, neighbor);
+
+        if (cost + step < search.costs[neighbor_index]) {
+          search.costs[neighbor_index] = cost + step;
+          search.links[neighbor_index] = item.index;
+          queue.push({ cost + step + heuristic(neighbor), neighbor_index });
+        }
+      }
+    }
+
+    return search;
+  }
+
+  const std::vector<gf::Vec2I>& HierarchicalPathfinder::refine_segment(Cluster& cluster, std::size_t from, std::size_t to)
+  {
+    const std::size_t key = from * cluster.portals.size() + to;
+
+    if (auto iterator = cluster.segments.find(key); iterator != cluster.segments.end()) {
+      return iterator->second;
+    }
+
+    const gf::Vec2I target = cluster.portals[to];
+    const AreaSearch search = search_area(cluster.area, cluster.portals[from], SearchDirection::Forward, target);
+    assert(search.costs[local_index(cluster.area, target)] < Infinity);
+
+    std::vector<gf::Vec2I> segment;
+
+    for (int32_t cell = local_index(cluster.area, target); cell != -1; cell = search.links[cell]) {
+      segment.push_back(local_position(cluster.area, cell));
+    }
+
+    std::reverse(segment.begin(), segment.end());
+    return cluster.segments.emplace(key, std::move(segment)).first->second;
+  }
+
+}
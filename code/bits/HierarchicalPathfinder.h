@@ -0,0 +1,112 @@
+#ifndef FW_HIERARCHICAL_PATHFINDER_H
+#define FW_HIERARCHICAL_PATHFINDER_H
+
+#include <cstdint>
+
+#include <functional>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include <gf2/core/GridMap.h>
+#include <gf2/core/Rect.h>
+#include <gf2/core/Vec2.h>
+
+#include "BitGrid.h"
+
+namespace fw {
+  class WorkerPool;
+
+  /*
+   * A hierarchical pathfinder (HPA*) on an orthogonal grid.
+   *
+   * The grid is divided in square clusters. Portals are put on the borders
+   * between the clusters and the costs between the portals of a cluster are
+   * precomputed. A route is first searched in the small graph of portals and
+   * then refined cluster by cluster. The refined segments are cached until the
+   * cluster changes.
+   *
+   * The distance function must not change during the life of the pathfinder,
+   * must be thread-safe (clusters are computed on the worker pool) and must
+   * return at least 1 for a step (the heuristic is the manhattan distance).
+   * Like gf::GridMap::compute_route(), the origin may be unwalkable but not
+   * the target.
+   */
+
+  class HierarchicalPathfinder {
+  public:
+    using DistanceFunction = std::function<float(gf::Vec2I, gf::Vec2I)>;
+
+    static constexpr int32_t DefaultClusterSize = 32;
+
+    HierarchicalPathfinder(const gf::GridMap& grid, DistanceFunction distance_function, WorkerPool& pool, int32_t cluster_size = DefaultClusterSize);
+
+    gf::Vec2I size() const
+    {
+      return m_walkable.size();
+    }
+
+    bool walkable(gf::Vec2I position) const
+    {
+      return m_walkable.test(position);
+    }
+
+    void set_walkable(gf::Vec2I position, bool walkable = true);
+
+    // the route includes the origin and the target, empty if there is no route
+    std::vector<gf::Vec2I> compute_route(gf::Vec2I origin, gf::Vec2I target);
+
+    // one search for all the targets, the routes share their refined segments
+    std::vector<std::vector<gf::Vec2I>> compute_routes(gf::Vec2I origin, std::span<const gf::Vec2I> targets);
+
+  private:
+    struct Cluster {
+      gf::RectI area;
+      std::vector<gf::Vec2I> portals; // sorted
+      std::vector<float> costs; // from portal (row) to portal (column)
+      std::unordered_map<std::size_t, std::vector<gf::Vec2I>> segments;
+      uint32_t first_node = 0;
+      bool dirty = true;
+    };
+
+    struct Link {
+      uint32_t node;
+      float cost;
+    };
+
+    enum class SearchDirection {
+      Forward,  // costs from the source
+      Backward, // costs to the source
+    };
+
+    struct AreaSearch {
+      gf::RectI area;
+      std::vector<float> costs;
+      std::vector<int32_t> links; // previous cell for Forward, next cell for Backward
+    };
+
+    std::size_t cluster_index(gf::Vec2I position) const;
+    uint32_t portal_node(gf::Vec2I position) const;
+
+    void update_graph();
+    std::vector<std::pair<gf::Vec2I, gf::Vec2I>> compute_transitions() const;
+    void compute_cluster_costs(Cluster& cluster) const;
+
+    AreaSearch search_area(gf::RectI area, gf::Vec2I source, SearchDirection direction, std::optional<gf::Vec2I> goal = std::nullopt) const;
+    const std::vector<gf::Vec2I>& refine_segment(Cluster& cluster, std::size_t from, std::size_t to);
+
+    BitGrid m_walkable;
+    DistanceFunction m_distance_function;
+    WorkerPool* m_pool = nullptr;
+    int32_t m_cluster_size = DefaultClusterSize;
+    gf::Vec2I m_cluster_count = { 0, 0 };
+    std::vector<Cluster> m_clusters;
+    std::vector<uint32_t> m_node_clusters;
+    std::vector<std::vector<Link>> m_node_links;
+    bool m_dirty = true;
+  };
+
+}
+
+#endif // FW_HIERARCHICAL_PATHFINDER_H
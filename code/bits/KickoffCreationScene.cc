@@ -64,6 +64,8 @@ namespace fw {
           return "Elevating buildings";
         case WorldGenerationStep::MapMinimap:
           return "Generating the minimaps";
+        case WorldGenerationStep::MapChunks:
+          return "Painting the surroundings";
         case WorldGenerationStep::Network:
           return "Tracing the railway network";
         case WorldGenerationStep::FirstTurn:
@@ -0,0 +1,81 @@
+#include "MapChunks.h"
+
+#include <cassert>
+
+#include <algorithm>
+#include <optional>
+
+namespace fw {
+
+  MapChunks::MapChunks(gf::Vec2I map_size)
+  : m_map_size(map_size)
+  , m_count((map_size.w + ChunkSize - 1) / ChunkSize, (map_size.h + ChunkSize - 1) / ChunkSize)
+  , m_status(std::make_unique<std::atomic<MapChunkStatus>[]>(static_cast<std::size_t>(m_count.w) * static_cast<std::size_t>(m_count.h)))
+  {
+  }
+
+  gf::RectI MapChunks::area(gf::Vec2I chunk) const
+  {
+    const gf::Vec2I min = chunk * ChunkSize;
+    const gf::Vec2I max = { std::min(min.x + ChunkSize, m_map_size.w), std::min(min.y + ChunkSize, m_map_size.h) };
+    return gf::RectI::from_min_max(min, max);
+  }
+
+  gf::RectI MapChunks::compute_covering_chunks(gf::RectI area) const
+  {
+    const std::optional<gf::RectI> clipped = gf::RectI::from_size(m_map_size).intersection(area);
+
+    if (!clipped) {
+      return gf::RectI::from_size({ 0, 0 });
+    }
+
+    const gf::Vec2I min = clipped->position() / ChunkSize;
+    const gf::Vec2I max = (clipped->position() + clipped->size() - 1) / ChunkSize + 1;
+    return gf::RectI::from_min_max(min, max);
+  }
+
+  bool MapChunks::claim(gf::Vec2I chunk)
+  {
+    MapChunkStatus expected = MapChunkStatus::Unbound;
+    return m_status[index(chunk)].compare_exchange_strong(expected, MapChunkStatus::Binding);
+  }
+
+  void MapChunks::set_bound(gf::Vec2I chunk)
+  {
+    std::atomic<MapChunkStatus>& status = m_status[index(chunk)];
+    assert(status.load() == MapChunkStatus::Binding);
+    status.store(MapChunkStatus::Bound);
+    status.notify_all();
+  }
+
+  void MapChunks::wait_bound(gf::Vec2I chunk) const
+  {
+    const std::atomic<MapChunkStatus>& status = m_status[index(chunk)];
+
+    for (MapChunkStatus current = status.load(); current != MapChunkStatus::Bound; current = status.load()) {
+      status.wait(current);
+    }
+  }
+
+  void MapChunks::unbind(gf::Vec2I chunk)
+  {
+    std::atomic<MapChunkStatus>& status = m_status[index(chunk)];
+    assert(status.load() != MapChunkStatus::Binding);
+    status.store(MapChunkStatus::Unbound);
+  }
+
+  bool MapChunks::claim_eviction(gf::Vec2I chunk)
+  {
+    MapChunkStatus expected = MapChunkStatus::Bound;
+    return m_status[index(chunk)].compare_exchange_strong(expected, MapChunkStatus::Binding);
+  }
+
+  void MapChunks::set_unbound(gf::Vec2I chunk)
+  {
+    std::atomic<MapChunkStatus>& status = m_status[index(chunk)];
+    assert(status.load() == MapChunkStatus::Binding);
+    status.store(MapChunkStatus::Unbound);
+    status.notify_all();
+  }
+
+}
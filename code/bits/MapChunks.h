@@ -0,0 +1,75 @@
+#ifndef FW_MAP_CHUNKS_H
+#define FW_MAP_CHUNKS_H
+
+#include <cstdint>
+
+#include <atomic>
+#include <memory>
+
+#include <gf2/core/Rect.h>
+#include <gf2/core/Vec2.h>
+
+#include "Settings.h"
+
+namespace fw {
+
+  enum class MapChunkStatus : uint8_t {
+    Unbound,
+    Binding,
+    Bound,
+  };
+
+  /*
+   * The status of the square chunks of a floor map.
+   *
+   * A chunk is claimed by one thread that binds it, the other threads that
+   * need it wait until it is bound.
+   */
+
+  class MapChunks {
+  public:
+    static constexpr int32_t ChunkSize = MapChunkSize;
+
+    MapChunks() = default;
+    explicit MapChunks(gf::Vec2I map_size);
+
+    gf::Vec2I count() const
+    {
+      return m_count;
+    }
+
+    std::size_t index(gf::Vec2I chunk) const
+    {
+      return static_cast<std::size_t>(chunk.x) + static_cast<std::size_t>(chunk.y) * static_cast<std::size_t>(m_count.w);
+    }
+
+    gf::RectI area(gf::Vec2I chunk) const;
+
+    // the chunks that cover the area (clipped to the map), in chunk coordinates
+    gf::RectI compute_covering_chunks(gf::RectI area) const;
+
+    bool bound(gf::Vec2I chunk) const
+    {
+      return m_status[index(chunk)].load() == MapChunkStatus::Bound;
+    }
+
+    // true if the caller must bind the chunk and then call set_bound()
+    bool claim(gf::Vec2I chunk);
+    void set_bound(gf::Vec2I chunk);
+    void wait_bound(gf::Vec2I chunk) const;
+    // when the state of the chunk changes, no thread must be binding it
+    void unbind(gf::Vec2I chunk);
+
+    // true if the caller must release the chunk and then call set_unbound()
+    bool claim_eviction(gf::Vec2I chunk);
+    void set_unbound(gf::Vec2I chunk);
+
+  private:
+    gf::Vec2I m_map_size = { 0, 0 };
+    gf::Vec2I m_count = { 0, 0 };
+    std::unique_ptr<std::atomic<MapChunkStatus>[]> m_status;
+  };
+
+}
+
+#endif // FW_MAP_CHUNKS_H
@@ -98,21 +98,21 @@ namespace fw {
 
     // get current view
 
-    const WorldRuntime* runtime = m_game->runtime();
+    WorldRuntime* runtime = m_game->runtime();
     const gf::RectI view = runtime->compute_view();
 
     // display map background
 
+    runtime->map.bind_view(hero_location.floor, view);
     const FloorMap& floor_map = runtime->map.from_floor(hero_location.floor);
-    gf::console_blit_to(floor_map.console, console, view, GameBoxPosition);
+    floor_map.blit_to(console, view, GameBoxPosition);
 
     const WorldState* state = m_game->state();
-    const BackgroundMap& map = state->map.from_floor(hero_location.floor);
 
     for (const gf::Vec2I position : gf::rectangle_range(view)) {
       // TODO: verify the position is in the map or clamp the view
 
-      const MapCell& cell = map(position);
+      const MapCell& cell = state->map.cell({ position, hero_location.floor });
       const gf::Vec2I console_position = position - view.position() + GameBoxPosition;
 
       constexpr gf::Color LightFadeColor = gf::gray(0.75f);
@@ -141,7 +141,7 @@ namespace fw {
         return false;
       }
 
-      if (!map(location.position).visible()) {
+      if (!state->map.cell({ location.position, hero_location.floor }).visible()) {
         return false;
       }
 
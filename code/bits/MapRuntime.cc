@@ -1,22 +1,31 @@
 #include "MapRuntime.h"
 
-#include <algorithm>
 #include <cstdint>
 
+#include <algorithm>
+#include <limits>
+#include <optional>
+#include <tuple>
+
+#include <gf2/core/Clock.h>
 #include <gf2/core/ConsoleChar.h>
 #include <gf2/core/ConsoleOperations.h>
 #include <gf2/core/Direction.h>
 #include <gf2/core/Easing.h>
+#include <gf2/core/Log.h>
 #include <gf2/core/Math.h>
 
+#include "BitGrid.h"
 #include "Colors.h"
 #include "MapCell.h"
 #include "MapCellBiome.h"
 #include "MapState.h"
 #include "MapBuilding.h"
 #include "NetworkState.h"
+#include "RandomStreams.h"
 #include "Settings.h"
 #include "Utils.h"
+#include "WorkerPool.h"
 #include "WorldState.h"
 #include "gf2/core/Color.h"
 
@@ -33,35 +42,132 @@ namespace fw {
     }
   }
 
+  void FloorMap::blit_to(gf::Console& console, gf::RectI view, gf::Vec2I destination) const
+  {
+    for (const gf::Vec2I chunk : gf::rectangle_range(chunks.compute_covering_chunks(view))) {
+      const std::shared_ptr<const gf::Console>& chunk_console = consoles[chunks.index(chunk)];
+      assert(chunk_console);
+
+      const gf::RectI area = chunks.area(chunk);
+      const std::optional<gf::RectI> visible = area.intersection(view);
+      assert(visible);
+
+      const gf::RectI source = gf::RectI::from_position_size(visible->position() - area.position(), visible->size());
+      gf::console_blit_to(*chunk_console, console, source, destination + visible->position() - view.position());
+    }
+  }
+
+  gf::Color FloorMap::background_color(gf::Vec2I position) const
+  {
+    const gf::Vec2I chunk = position / MapChunks::ChunkSize;
+    const std::shared_ptr<const gf::Console>& chunk_console = consoles[chunks.index(chunk)];
+    assert(chunk_console);
+    return (*chunk_console)(position - chunks.area(chunk).position()).parts[0].background;
+  }
+
   namespace {
 
     constexpr float ColorLighterBound = 0.03f;
 
-    char16_t generate_character(std::initializer_list<char16_t> list, gf::Random* random)
-    {
-      assert(list.size() > 0);
-      const std::size_t index = random->compute_uniform_integer(list.size());
-      assert(index < list.size());
-      return std::data(list)[index];
-    }
+    // the chunks of a floor that keep their console, about 16 times the chunks of a view
+    constexpr std::size_t MapConsoleChunkBudget = 64;
+    // the chunks bound in the background around the view, (2 * radius + 1)² per floor, less than the budget
+    constexpr int32_t WarmUpChunkRadius = 2;
+    static_assert(static_cast<std::size_t>(gf::square(2 * WarmUpChunkRadius + 1)) + 4 <= MapConsoleChunkBudget);
+
+    /*
+     * The appearance of a cell only depends on the seed, the layer (a step of
+     * the binding), the position and a counter for the different draws of the
+     * cell. So a cell can be drawn again in any order and on any thread.
+     */
+
+    constexpr uint64_t JitterDraw = 0;
+    constexpr uint64_t GlyphDraw = 1;
+    constexpr uint64_t PresenceDraw = 2;
+    constexpr uint64_t StreetJitterDraw = 3;
+    constexpr uint64_t StreetPresenceDraw = 4;
+
+    struct Appearance {
+      const RandomStreams* streams;
+      WorldGenerationStep layer;
+
+      float compute_uniform_float(gf::Vec2I position, uint64_t draw, float min, float max) const
+      {
+        return min + (max - min) * streams->compute_uniform_float(layer, position, draw);
+      }
+
+      bool compute_bernoulli(gf::Vec2I position, uint64_t draw, double probability) const
+      {
+        return streams->compute_bernoulli(layer, position, probability, draw);
+      }
 
-    template<typename T, T MapCell::* Field>
-    uint8_t compute_neighbor_bits(const BackgroundMap& state, gf::Vec2I position, T type)
+      char16_t compute_character(gf::Vec2I position, std::initializer_list<char16_t> list) const
+      {
+        assert(list.size() > 0);
+        const auto index = static_cast<std::size_t>(streams->compute_uniform_float(layer, position, GlyphDraw) * static_cast<float>(list.size()));
+        return std::data(list)[std::min(index, list.size() - 1)];
+      }
+    };
+
+    // the water and the cliffs of the area and its border are read in one pass, the cells outside the map count as both
+    // nothing if the area has neither water nor cliff
+    template<typename Map>
+    std::optional<BitNeighborPlanes> compute_autotile_planes(const Map& state, gf::RectI area)
     {
-      uint8_t neighbor_bits = 0b0000;
-      uint8_t direction_bit = 0b0001;
+      using Word = BitGrid::Word;
+
+      const gf::RectI extended = area.grow_by(1);
+      const gf::Vec2I size = extended.size();
+      BitGrid water(size, true);
+      BitGrid cliff(size, true);
+      Word autotiled = 0;
+
+      // the bits of [first, last) in a word
+      auto compute_bits = [](int32_t first, int32_t last) {
+        auto low_bits = [](int32_t count) { return count >= BitGrid::WordBits ? ~Word(0) : (Word(1) << std::max(count, 0)) - 1; };
+        return low_bits(last) & ~low_bits(first);
+      };
+
+      // the cells of the extended area inside the map, the others stay set
+      const std::optional<gf::RectI> inside = gf::RectI::from_size(state.size()).intersection(extended);
+      assert(inside);
+      const gf::Vec2I min = inside->position() - extended.position();
+      const gf::Vec2I max = min + inside->size();
+
+      for (int32_t y = min.y; y < max.y; ++y) {
+        for (int32_t x = 0; x < water.row_words(); ++x) {
+          const int32_t offset = x * BitGrid::WordBits;
+          const int32_t first = std::max(min.x, offset);
+          const int32_t last = std::min(max.x, offset + BitGrid::WordBits);
+          Word water_word = 0;
+          Word cliff_word = 0;
+
+          for (int32_t i = first; i < last; ++i) {
+            const MapCellDecoration decoration = state(extended.position() + gf::vec(i, y)).decoration;
+            water_word |= Word(decoration == MapCellDecoration::Water) << (i - offset);
+            cliff_word |= Word(decoration == MapCellDecoration::Cliff) << (i - offset);
+          }
 
-      for (const gf::Orientation orientation : { gf::Orientation::North, gf::Orientation::East, gf::Orientation::South, gf::Orientation::West }) {
-        const gf::Vec2I target = position + gf::displacement(orientation);
+          if (0 < y && y <= area.size().h) {
+            autotiled |= (water_word | cliff_word) & compute_bits(1 - offset, area.size().w + 1 - offset);
+          }
 
-        if (!state.valid(target) || state(target).*Field == type) {
-          neighbor_bits |= direction_bit;
+          // the word of the grid only has the bits inside the grid
+          const Word outside = ~compute_bits(first - offset, last - offset);
+          water.word(x, y) &= water_word | outside;
+          cliff.word(x, y) &= cliff_word | outside;
         }
+      }
 
-        direction_bit <<= 1;
+      if (autotiled == 0) {
+        return std::nullopt;
       }
 
-      return neighbor_bits;
+      // a cell is either water or cliff, so both classes share the planes
+      BitNeighborPlanes planes(area.size());
+      add_neighbor_planes(water, planes);
+      add_neighbor_planes(cliff, planes);
+      return planes;
     }
 
   }
@@ -96,29 +202,222 @@ namespace fw {
     return ground;
   }
 
-  void MapRuntime::bind(const WorldState& state, gf::Random* random, WorldGenerationAnalysis& analysis)
+  void MapRuntime::bind(const WorldState& state, WorldGenerationAnalysis& analysis, std::size_t thread_count)
   {
+    stop_binding();
+
+    m_state = &state;
+    // the same appearance for the same world, even after a load
+    m_streams = RandomStreams(state.seed);
+
+    // the same for a new game and a loaded save
+    WorkerPool pool(thread_count);
+
     analysis.set_step(WorldGenerationStep::MapGround);
-    bind_ground(state, random);
+    bind_ground(state, pool);
     analysis.set_step(WorldGenerationStep::MapUnderground);
-    bind_underground(state, random);
+    bind_underground(state, pool);
     analysis.set_step(WorldGenerationStep::MapRails);
-    bind_railway(state);
+    bind_railway(state, pool);
     analysis.set_step(WorldGenerationStep::MapRoads);
-    bind_roads(state, random);
-    analysis.set_step(WorldGenerationStep::MapTowns);
-    bind_towns(state, random);
+    bind_roads(state, pool);
 
     analysis.set_step(WorldGenerationStep::MapBuildings);
-    bind_buildings(state);
+    bind_buildings(state, pool);
 
     analysis.set_step(WorldGenerationStep::MapMinimap);
-    bind_minimaps(state);
+    bind_minimaps(state, pool);
+
+    // the console around the hero is needed for the first frame, the chunks around are bound in the background
+
+    analysis.set_step(WorldGenerationStep::MapChunks);
+    const Location origin = state.hero().location();
+    m_uses = 0;
+    m_warm_up_origin = { origin.position / MapChunks::ChunkSize, origin.floor };
+    bind_view(origin.floor, gf::RectI::from_center_size(origin.position, 2 * GameBoxSize));
+    start_binding(origin);
+  }
+
+  void MapRuntime::bind_view(Floor floor, gf::RectI view)
+  {
+    FloorMap& map = from_floor(floor);
+    MapChunks& chunks = map.chunks;
+    const uint64_t use = ++m_uses;
+
+    for (const gf::Vec2I chunk : gf::rectangle_range(chunks.compute_covering_chunks(view))) {
+      if (!chunks.bound(chunk)) {
+        if (chunks.claim(chunk)) {
+          bind_chunk(floor, chunk);
+          chunks.set_bound(chunk);
+        } else {
+          // the binder is on it
+          chunks.wait_bound(chunk);
+        }
+      }
+
+      map.last_uses[chunks.index(chunk)] = use;
+    }
+
+    evict_chunks(map, use);
+
+    // the chunks around the hero are bound in the background when the hero moves to another chunk
+    if (m_state == nullptr) {
+      return;
+    }
+
+    const Location hero = m_state->hero().location();
+    const Location hero_chunk = { hero.position / MapChunks::ChunkSize, hero.floor };
+
+    if (hero_chunk.position != m_warm_up_origin.position || hero_chunk.floor != m_warm_up_origin.floor) {
+      m_warm_up_origin = hero_chunk;
+      stop_binding();
+      start_binding(hero);
+    }
+  }
+
+  void MapRuntime::evict_chunks(FloorMap& map, uint64_t current_use)
+  {
+    std::vector<gf::Vec2I> candidates;
+    std::size_t owned_count = 0;
+
+    for (const gf::Vec2I chunk : gf::position_range(map.chunks.count())) {
+      // the binder does not touch the bound chunks
+      if (!map.chunks.bound(chunk)) {
+        continue;
+      }
+
+      const std::size_t index = map.chunks.index(chunk);
+
+      if (map.consoles[index] == m_rock_console) {
+        continue; // shared
+      }
+
+      ++owned_count;
+
+      if (map.last_uses[index] != current_use) {
+        candidates.push_back(chunk);
+      }
+    }
+
+    if (owned_count <= MapConsoleChunkBudget) {
+      return;
+    }
+
+    // least recently used first
+    std::sort(candidates.begin(), candidates.end(), [&map](gf::Vec2I lhs, gf::Vec2I rhs) {
+      return map.last_uses[map.chunks.index(lhs)] < map.last_uses[map.chunks.index(rhs)];
+    });
+
+    const std::size_t eviction_count = std::min(owned_count - MapConsoleChunkBudget, candidates.size());
+
+    for (std::size_t i = 0; i < eviction_count; ++i) {
+      const gf::Vec2I chunk = candidates[i];
+
+      if (map.chunks.claim_eviction(chunk)) {
+        map.consoles[map.chunks.index(chunk)].reset();
+        map.chunks.set_unbound(chunk);
+      }
+    }
+  }
+
+  void MapRuntime::stop_binding()
+  {
+    if (m_binder.joinable()) {
+      m_binder.request_stop();
+      m_binder.join();
+    }
+  }
+
+  void MapRuntime::resume_binding()
+  {
+    assert(!m_binder.joinable());
+    assert(m_state != nullptr);
+    start_binding(m_state->hero().location());
+  }
+
+  void MapRuntime::bind_cave(const WorldState& state, gf::RectI area)
+  {
+    assert(!m_binder.joinable());
+    assert(m_state == &state);
+
+    const std::optional<gf::RectI> clipped = gf::RectI::from_size(WorldSize).intersection(area);
+
+    if (!clipped) {
+      return;
+    }
+
+    for (const gf::Vec2I position : gf::rectangle_range(*clipped)) {
+      if (is_walkable(state.map.underground(position).decoration)) {
+        underground.background(position).properties.set(RuntimeMapCellProperty::Walkable);
+      } else {
+        underground.background(position).properties.reset(RuntimeMapCellProperty::Walkable);
+      }
+    }
+
+    // the chunks are bound again when they are viewed or by the binder
+    for (const gf::Vec2I chunk : gf::rectangle_range(underground.chunks.compute_covering_chunks(*clipped))) {
+      underground.chunks.unbind(chunk);
+    }
+
+    start_binding(state.hero().location());
+  }
+
+  void MapRuntime::start_binding(Location origin)
+  {
+    m_binder = std::jthread([this, origin](std::stop_token token) {
+      warm_up_chunks(token, origin);
+    });
+  }
+
+  void MapRuntime::warm_up_chunks(std::stop_token token, Location origin)
+  {
+    struct FloorChunk {
+      Floor floor;
+      gf::Vec2I chunk;
+      int32_t distance;
+    };
+
+    const gf::Vec2I origin_chunk = origin.position / MapChunks::ChunkSize;
+    std::vector<FloorChunk> remaining;
+
+    for (const Floor floor : { Floor::Ground, Floor::Underground }) {
+      const MapChunks& chunks = from_floor(floor).chunks;
+
+      const gf::RectI around = gf::RectI::from_center_size(origin_chunk, gf::vec(2 * WarmUpChunkRadius + 1, 2 * WarmUpChunkRadius + 1));
+
+      for (const gf::Vec2I chunk : gf::rectangle_range(gf::RectI::from_size(chunks.count()).intersection(around).value_or(gf::RectI::from_size({ 0, 0 })))) {
+        if (!chunks.bound(chunk)) {
+          remaining.push_back({ floor, chunk, gf::chebyshev_distance(chunk, origin_chunk) });
+        }
+      }
+    }
+
+    // nearest chunks first, the floor of the hero first
+    std::stable_sort(remaining.begin(), remaining.end(), [&origin](const FloorChunk& lhs, const FloorChunk& rhs) {
+      return std::tuple(lhs.distance, lhs.floor != origin.floor) < std::tuple(rhs.distance, rhs.floor != origin.floor);
+    });
+
+    gf::Clock clock;
+
+    for (const FloorChunk& remaining_chunk : remaining) {
+      if (token.stop_requested()) {
+        return;
+      }
+
+      MapChunks& chunks = from_floor(remaining_chunk.floor).chunks;
+
+      if (chunks.claim(remaining_chunk.chunk)) {
+        bind_chunk(remaining_chunk.floor, remaining_chunk.chunk);
+        chunks.set_bound(remaining_chunk.chunk);
+      }
+    }
+
+    gf::Log::debug("Map chunks warmed up in the background in {:g}s", clock.elapsed_time().as_seconds());
   }
 
   namespace {
 
-    std::tuple<char16_t, gf::Color> compute_decoration(const BackgroundMap& state, gf::Vec2I position, MapCellDecoration decoration, gf::Color background_color, gf::Random* random)
+    std::tuple<char16_t, gf::Color> compute_decoration(gf::Vec2I position, MapCellDecoration decoration, uint8_t neighbor_bits, gf::Color background_color, const Appearance& appearance)
     {
       gf::Color foreground_color = gf::Transparent;
       char16_t character = u' ';
@@ -135,21 +434,19 @@ namespace fw {
           foreground_color = gf::darker(background_color);
           break;
         case MapCellDecoration::Herb:
-          character = generate_character({ u'.', u',', u'`', u'\'' /*, gf::ConsoleChar::SquareRoot */ }, random);
+          character = appearance.compute_character(position, { u'.', u',', u'`', u'\'' /*, gf::ConsoleChar::SquareRoot */ });
           foreground_color = gf::darker(background_color, 0.1f);
           break;
         case MapCellDecoration::Cactus:
-          character = generate_character({ u'!', gf::ConsoleChar::InvertedExclamationMark }, random);
+          character = appearance.compute_character(position, { u'!', gf::ConsoleChar::InvertedExclamationMark });
           foreground_color = gf::darker(gf::Green, 0.3f);
           break;
         case MapCellDecoration::Tree:
-          character = generate_character({ u'φ', u'ψ', u'¥' }, random);
+          character = appearance.compute_character(position, { u'φ', u'ψ', u'¥' });
           foreground_color = gf::darker(gf::Green, 0.7f);
           break;
         case MapCellDecoration::Water:
           {
-            const uint8_t neighbor_bits = compute_neighbor_bits<MapCellDecoration, &MapCell::decoration>(state, position, MapCellDecoration::Water);
-
             // clang-format off
             constexpr char16_t BlockCharacters[] = {
                                                     // WSEN
@@ -179,8 +476,6 @@ namespace fw {
           break;
         case MapCellDecoration::Cliff:
           {
-            const uint8_t neighbor_bits = compute_neighbor_bits<MapCellDecoration, &MapCell::decoration>(state, position, MapCellDecoration::Cliff);
-
             // clang-format off
             constexpr char16_t BlockCharacters[] = {
                                                     // WSEN
@@ -221,10 +516,42 @@ namespace fw {
       return { character, foreground_color };
     }
 
-    void bind_floor_map(const BackgroundMap& state, FloorMap& map, gf::Random* random)
+    /*
+     * The whole floors are bound in bands of rows on a worker pool, one row of
+     * chunks per band. The cells of a band are only written by its task.
+     */
+
+    std::size_t compute_band_count(const FloorMap& map)
+    {
+      return static_cast<std::size_t>(map.chunks.count().h);
+    }
+
+    gf::RectI compute_band(const FloorMap& map, std::size_t band)
+    {
+      const gf::RectI first_chunk = map.chunks.area({ 0, static_cast<int32_t>(band) });
+      return gf::RectI::from_position_size(first_chunk.position(), { map.background.size().w, first_chunk.size().h });
+    }
+
+    template<typename Map>
+    void bind_floor_walkability(const Map& state, FloorMap& map, WorkerPool& pool)
     {
-      for (const gf::Vec2I position : state.position_range()) {
+      pool.parallel_for(compute_band_count(map), [&](std::size_t band) {
+        for (const gf::Vec2I position : gf::rectangle_range(compute_band(map, band))) {
+          if (!is_walkable(state(position).decoration)) {
+            map.background(position).properties.reset(RuntimeMapCellProperty::Walkable);
+          }
+        }
+      });
+    }
+
+    template<typename Map>
+    void bind_floor_chunk(const Map& state, gf::Console& console, gf::RectI area, const Appearance& appearance)
+    {
+      const std::optional<BitNeighborPlanes> planes = compute_autotile_planes(state, area);
+
+      for (const gf::Vec2I position : gf::rectangle_range(area)) {
         const MapCell& cell = state(position);
+        const gf::Vec2I local_position = position - area.position();
 
         gf::Color background_color = gf::White;
 
@@ -253,30 +580,34 @@ namespace fw {
 
         }
 
-        background_color = gf::lighter(background_color, random->compute_uniform_float(0.0f, ColorLighterBound));
-        const auto [ character, foreground_color ] = compute_decoration(state, position, cell.decoration, background_color, random);
-        gf::console_write_picture(map.console, position, character, { foreground_color, background_color });
-
-        if (!is_walkable(cell.decoration)) {
-          map.background(position).properties.reset(RuntimeMapCellProperty::Walkable);
-        }
+        background_color = gf::lighter(background_color, appearance.compute_uniform_float(position, JitterDraw, 0.0f, ColorLighterBound));
+        const bool autotiled = cell.decoration == MapCellDecoration::Water || cell.decoration == MapCellDecoration::Cliff;
+        const uint8_t neighbor_bits = autotiled ? planes->mask(local_position) : 0;
+        const auto [ character, foreground_color ] = compute_decoration(position, cell.decoration, neighbor_bits, background_color, appearance);
+        gf::console_write_picture(console, local_position, character, { foreground_color, background_color });
       }
     }
 
-
   }
 
-  void MapRuntime::bind_ground(const WorldState& state, gf::Random* random)
+  void MapRuntime::bind_ground(const WorldState& state, WorkerPool& pool)
   {
     ground = FloorMap(WorldSize);
-    bind_floor_map(state.map.ground, ground, random);
+    bind_floor_walkability(state.map.ground, ground, pool);
   }
 
 
-  void MapRuntime::bind_underground(const WorldState& state, gf::Random* random)
+  void MapRuntime::bind_underground(const WorldState& state, WorkerPool& pool)
   {
     underground = FloorMap(WorldSize);
-    bind_floor_map(state.map.underground, underground, random);
+    bind_floor_walkability(state.map.underground, underground, pool);
+
+    // the console of a chunk that has never been dug
+    const gf::RectI area = gf::RectI::from_size({ MapChunks::ChunkSize, MapChunks::ChunkSize });
+    const UndergroundMap rock(area.size(), state.map.underground.fill_value());
+    auto console = std::make_shared<gf::Console>(area.size());
+    bind_floor_chunk(rock, *console, area, Appearance{ &m_streams, WorldGenerationStep::MapUnderground });
+    m_rock_console = std::move(console);
   }
 
   namespace {
@@ -345,17 +676,10 @@ namespace fw {
       return RailNS;
     }
 
-  }
-
-  void MapRuntime::bind_railway(const WorldState& state)
-  {
-    gf::ConsoleStyle default_style = gf::Black;
-
-    const std::vector<gf::Vec2I>& railway = state.network.railway;
-
-    // put railway on the map
+    const RailPlan& compute_railway_plan(const std::vector<gf::Vec2I>& railway, std::size_t index)
+    {
+      const gf::Vec2I position = railway[index];
 
-    for (const auto [ index, position ] : gf::enumerate(railway)) {
       const std::size_t index_before = (index + railway.size() - 1) % railway.size();
       const gf::Vec2I position_before = railway[index_before];
       const gf::Direction direction_before = undisplacement(gf::sign(position_before - position));
@@ -364,132 +688,219 @@ namespace fw {
       const gf::Vec2I position_after = railway[index_after];
       const gf::Direction direction_after = undisplacement(gf::sign(position_after - position));
 
-      const RailPlan& plan = compute_rail_plan(direction_before, direction_after);
+      return compute_rail_plan(direction_before, direction_after);
+    }
 
-      for (int i = -1; i <= +1; ++i) {
-        for (int j = -1; j <= +1; ++j) {
-          const gf::Vec2I neighbor(i, j);
-          const gf::Vec2I neighbor_position = position + neighbor;
+    // the railway and the roads are drawn on the 3x3 square around their positions
+    gf::RectI compute_network_chunks(const MapChunks& chunks, gf::Vec2I position)
+    {
+      return chunks.compute_covering_chunks(gf::RectI::from_center_size(position, { 3, 3 }));
+    }
 
-          gf::ConsoleStyle style = default_style;
+    std::size_t compute_chunk_count(const MapChunks& chunks)
+    {
+      const gf::Vec2I count = chunks.count();
+      return static_cast<std::size_t>(count.w) * static_cast<std::size_t>(count.h);
+    }
 
-          if (state.map.ground(neighbor_position).decoration == MapCellDecoration::Water) {
-            // put a wooden bridge
-            ground.background(neighbor_position).properties.set(RuntimeMapCellProperty::Walkable);
-            style = { gf::Black, BridgeColor };
-          }
+    void bind_railway_chunk(const WorldState& state, gf::Console& console, gf::RectI area, const std::vector<uint32_t>& indices)
+    {
+      const gf::ConsoleStyle default_style = gf::Black;
+      const std::vector<gf::Vec2I>& railway = state.network.railway;
+
+      for (const uint32_t index : indices) {
+        const gf::Vec2I position = railway[index];
+        const RailPlan& plan = compute_railway_plan(railway, index);
+
+        for (int i = -1; i <= +1; ++i) {
+          for (int j = -1; j <= +1; ++j) {
+            const gf::Vec2I neighbor(i, j);
+            const gf::Vec2I neighbor_position = position + neighbor;
+
+            if (!area.contains(neighbor_position)) {
+              continue;
+            }
+
+            gf::ConsoleStyle style = default_style;
 
-          gf::console_write_picture(ground.console, neighbor_position, plan[neighbor.y + 1][neighbor.x + 1], style);
+            if (state.map.ground(neighbor_position).decoration == MapCellDecoration::Water) {
+              // put a wooden bridge
+              style = { gf::Black, BridgeColor };
+            }
+
+            gf::console_write_picture(console, neighbor_position - area.position(), plan[neighbor.y + 1][neighbor.x + 1], style);
+          }
         }
       }
     }
-  }
 
-  void MapRuntime::bind_roads(const WorldState& state, gf::Random* random)
-  {
-    const gf::ConsoleEffect road_effect = gf::ConsoleEffect::multiply();
-    const std::vector<gf::Vec2I>& roads = state.network.roads;
+    void bind_roads_chunk(const WorldState& state, gf::Console& console, gf::RectI area, const std::vector<gf::Vec2I>& roads, const Appearance& appearance)
+    {
+      const gf::ConsoleEffect road_effect = gf::ConsoleEffect::multiply();
 
-    for (const gf::Vec2I position : roads) {
-      for (int i = -1; i <= +1; ++i) {
-        for (int j = -1; j <= +1; ++j) {
-          const gf::Vec2I neighbor(i, j);
-          const gf::Vec2I neighbor_position = position + neighbor;
-
-          if (state.map.ground(neighbor_position).decoration == MapCellDecoration::Water) {
-            ground.background(neighbor_position).properties.set(RuntimeMapCellProperty::Walkable);
-            gf::console_write_picture(ground.console, neighbor_position, ' ', { gf::Transparent, BridgeColor });
-          } else {
-            if (random->compute_bernoulli(RoadColorProbability)) {
-              gf::Color color = gf::lighter(gf::gray(0.9f), random->compute_uniform_float(0.0f, ColorLighterBound));
-              gf::console_write_background(ground.console, neighbor_position, color, road_effect);
+      for (const gf::Vec2I position : roads) {
+        for (int i = -1; i <= +1; ++i) {
+          for (int j = -1; j <= +1; ++j) {
+            const gf::Vec2I neighbor(i, j);
+            const gf::Vec2I neighbor_position = position + neighbor;
+
+            if (!area.contains(neighbor_position)) {
+              continue;
+            }
+
+            if (state.map.ground(neighbor_position).decoration == MapCellDecoration::Water) {
+              gf::console_write_picture(console, neighbor_position - area.position(), ' ', { gf::Transparent, BridgeColor });
+            } else {
+              if (appearance.compute_bernoulli(neighbor_position, PresenceDraw, RoadColorProbability)) {
+                gf::Color color = gf::lighter(gf::gray(0.9f), appearance.compute_uniform_float(neighbor_position, JitterDraw, 0.0f, ColorLighterBound));
+                gf::console_write_background(console, neighbor_position - area.position(), color, road_effect);
+              }
             }
           }
         }
       }
     }
 
-  }
+    void bind_towns_chunk(const WorldState& state, gf::Console& console, gf::RectI area, const Appearance& appearance)
+    {
+      const gf::ConsoleEffect street_effect = gf::ConsoleEffect::alpha();
 
-  void MapRuntime::bind_towns(const WorldState& state, gf::Random* random)
-  {
-    const gf::ConsoleEffect street_effect = gf::ConsoleEffect::alpha();
+      auto compute_street_blend_color = [&appearance](gf::Vec2I position, uint64_t draw) {
+        return gf::lighter(StreetColor, appearance.compute_uniform_float(position, draw, 0.0f, ColorLighterBound)) * gf::opaque(0.5f);
+      };
 
-    auto compute_street_blend_color = [random]() {
-      return gf::lighter(StreetColor, random->compute_uniform_float(0.0f, ColorLighterBound)) * gf::opaque(0.5f);
-    };
+      auto write_street = [&](gf::Vec2I position) {
+        if (area.contains(position) && appearance.compute_bernoulli(position, StreetPresenceDraw, StreetColorProbability)) {
+          const gf::Color color = compute_street_blend_color(position, StreetJitterDraw);
+          gf::console_write_background(console, position - area.position(), color, street_effect);
+        }
+      };
 
-    for (const TownState& town : state.map.towns) {
-      const gf::RectI town_space = gf::RectI::from_position_size(town.position, { TownDiameter, TownDiameter });
-      const gf::Vec2I town_center = town_space.center();
+      static constexpr int32_t Extra = 5;
 
-      for (const gf::Vec2I position : gf::rectangle_range(town_space)) {
-        const float distance = gf::chebyshev_distance<float>(position, town_center);
-        const float factor = (TownRadius - distance) / TownRadius;
-        assert(0.0f <= factor && factor <= 1.0f);
-        const float probability = 0.1f * gf::ease_out_quint(factor);
+      for (const TownState& town : state.map.towns) {
+        const gf::RectI town_space = gf::RectI::from_position_size(town.position, { TownDiameter, TownDiameter });
+        const gf::RectI street_space = gf::RectI::from_position_size(town.position - (Extra + 1), { TownDiameter + 2 * (Extra + 1), TownDiameter + 2 * (Extra + 1) });
 
-        if (random->compute_bernoulli(probability)) {
-          const gf::Color color = compute_street_blend_color();
-          gf::console_write_background(ground.console, position, color, street_effect);
+        if (!street_space.intersection(area)) {
+          continue;
         }
-      }
-    }
 
-    // streets
+        const gf::Vec2I town_center = town_space.center();
 
-    for (const TownState& town : state.map.towns) {
-      const int32_t horizontal_street = town.horizontal_street * (TownBuildingSize + StreetSize) - 2;
-      const gf::Vec2I horizontal_position = town.position + gf::diry(horizontal_street);
+        for (const gf::Vec2I position : gf::rectangle_range(town_space)) {
+          if (!area.contains(position)) {
+            continue;
+          }
 
-      const int32_t vertical_street = town.vertical_street * (TownBuildingSize + StreetSize) - 2;
-      const gf::Vec2I vertical_position = town.position + gf::dirx(vertical_street);
+          const float distance = gf::chebyshev_distance<float>(position, town_center);
+          const float factor = (TownRadius - distance) / TownRadius;
+          assert(0.0f <= factor && factor <= 1.0f);
+          const float probability = 0.1f * gf::ease_out_quint(factor);
 
-      static constexpr int32_t Extra = 5;
+          if (appearance.compute_bernoulli(position, PresenceDraw, probability)) {
+            const gf::Color color = compute_street_blend_color(position, JitterDraw);
+            gf::console_write_background(console, position - area.position(), color, street_effect);
+          }
+        }
 
-      for (int32_t i = -Extra; i < TownDiameter + Extra; ++i) {
-        const gf::Vec2I position = horizontal_position + gf::dirx(i);
+        // streets
 
-        if (random->compute_bernoulli(StreetColorProbability)) {
-          const gf::Color color = compute_street_blend_color();
-          gf::console_write_background(ground.console, position, color, street_effect);
-        }
+        const int32_t horizontal_street = town.horizontal_street * (TownBuildingSize + StreetSize) - 2;
+        const gf::Vec2I horizontal_position = town.position + gf::diry(horizontal_street);
+
+        const int32_t vertical_street = town.vertical_street * (TownBuildingSize + StreetSize) - 2;
+        const gf::Vec2I vertical_position = town.position + gf::dirx(vertical_street);
+
+        for (int32_t i = -Extra; i < TownDiameter + Extra; ++i) {
+          const gf::Vec2I position = horizontal_position + gf::dirx(i);
+          write_street(position);
 
-        if (position.x != vertical_position.x) {
-          if (random->compute_bernoulli(StreetColorProbability)) {
-            const gf::Color color = compute_street_blend_color();
-            gf::console_write_background(ground.console, position + gf::diry(-1), color, street_effect);
+          if (position.x != vertical_position.x) {
+            write_street(position + gf::diry(-1));
+            write_street(position + gf::diry(+1));
           }
+        }
+
+        for (int32_t i = -Extra; i < TownDiameter + Extra; ++i) {
+          const gf::Vec2I position = vertical_position + gf::diry(i);
+          write_street(position);
 
-          if (random->compute_bernoulli(StreetColorProbability)) {
-            const gf::Color color = compute_street_blend_color();
-            gf::console_write_background(ground.console, position + gf::diry(+1), color, street_effect);
+          if (position.y != horizontal_position.y) {
+            write_street(position + gf::dirx(-1));
+            write_street(position + gf::dirx(+1));
           }
         }
       }
+    }
 
+  }
 
-      for (int32_t i = -Extra; i < TownDiameter + Extra; ++i) {
-        const gf::Vec2I position = vertical_position + gf::diry(i);
+  namespace {
 
-        if (random->compute_bernoulli(StreetColorProbability)) {
-          const gf::Color color = compute_street_blend_color();
-          gf::console_write_background(ground.console, position, color, street_effect);
+    // a wooden bridge on the water around each point of the network
+    void bind_bridges(const WorldState& state, FloorMap& map, const std::vector<gf::Vec2I>& points, WorkerPool& pool)
+    {
+      // each band gets the points of the rows around it, so that the bridges across two bands are set by both
+      std::vector<std::vector<gf::Vec2I>> band_points(compute_band_count(map));
+      const int32_t band_size = map.chunks.area({ 0, 0 }).size().h;
+
+      for (const gf::Vec2I position : points) {
+        const int32_t min_band = std::max(position.y - 1, 0) / band_size;
+        const int32_t max_band = std::min(position.y + 1, map.background.size().h - 1) / band_size;
+
+        for (int32_t band = min_band; band <= max_band; ++band) {
+          band_points[static_cast<std::size_t>(band)].push_back(position);
         }
+      }
 
-        if (position.y != horizontal_position.y) {
-          if (random->compute_bernoulli(StreetColorProbability)) {
-            const gf::Color color = compute_street_blend_color();
-            gf::console_write_background(ground.console, position + gf::dirx(-1), color, street_effect);
-          }
+      pool.parallel_for(band_points.size(), [&](std::size_t band) {
+        const gf::RectI area = compute_band(map, band);
 
-          if (random->compute_bernoulli(StreetColorProbability)) {
-            const gf::Color color = compute_street_blend_color();
-            gf::console_write_background(ground.console, position + gf::dirx(+1), color, street_effect);
+        for (const gf::Vec2I position : band_points[band]) {
+          for (int i = -1; i <= +1; ++i) {
+            for (int j = -1; j <= +1; ++j) {
+              const gf::Vec2I neighbor_position = position + gf::vec(i, j);
+
+              if (area.contains(neighbor_position) && state.map.ground(neighbor_position).decoration == MapCellDecoration::Water) {
+                map.background(neighbor_position).properties.set(RuntimeMapCellProperty::Walkable);
+              }
+            }
           }
         }
+      });
+    }
+
+  }
+
+  void MapRuntime::bind_railway(const WorldState& state, WorkerPool& pool)
+  {
+    const std::vector<gf::Vec2I>& railway = state.network.railway;
+    bind_bridges(state, ground, railway, pool);
+
+    // the pictures are put on the map with the chunks, in the order of the railway
+
+    m_railway_chunks.assign(compute_chunk_count(ground.chunks), {});
+
+    for (const auto [ index, position ] : gf::enumerate(railway)) {
+      for (const gf::Vec2I chunk : gf::rectangle_range(compute_network_chunks(ground.chunks, position))) {
+        m_railway_chunks[ground.chunks.index(chunk)].push_back(static_cast<uint32_t>(index));
       }
-   }
+    }
+  }
+
+  void MapRuntime::bind_roads(const WorldState& state, WorkerPool& pool)
+  {
+    const std::vector<gf::Vec2I> roads = state.network.compute_road_points();
+    bind_bridges(state, ground, roads, pool);
+
+    m_road_chunks.assign(compute_chunk_count(ground.chunks), {});
+
+    for (const gf::Vec2I position : roads) {
+      for (const gf::Vec2I chunk : gf::rectangle_range(compute_network_chunks(ground.chunks, position))) {
+        m_road_chunks[ground.chunks.index(chunk)].push_back(position);
+      }
+    }
   }
 
   // void MapRuntime::blur(const WorldState& state)
@@ -550,88 +961,138 @@ namespace fw {
 
   }
 
-  void MapRuntime::bind_buildings(const WorldState& state)
-  {
-    // buildings
+  namespace {
 
-    for (const TownState& town : state.map.towns) {
-      for (int32_t i = 0; i < TownsBlockSize; ++i) {
-        for (int32_t j = 0; j < TownsBlockSize; ++j) {
-          const gf::Vec2I block_position = { i, j };
-          const Building& building = town(block_position);
+    template<typename Function>
+    void for_each_building_part(const WorldState& state, gf::RectI area, Function function)
+    {
+      for (const TownState& town : state.map.towns) {
+        const gf::RectI town_space = gf::RectI::from_position_size(town.position, { TownDiameter, TownDiameter });
 
-          if (building.type == BuildingType::Empty || building.type == BuildingType::None) {
-            continue;
-          }
+        if (!town_space.intersection(area)) {
+          continue;
+        }
 
-          const TownBuildingPlan& plan = compute_town_building_plan(building.type);
+        for (int32_t i = 0; i < TownsBlockSize; ++i) {
+          for (int32_t j = 0; j < TownsBlockSize; ++j) {
+            const gf::Vec2I block_position = { i, j };
+            const Building& building = town(block_position);
 
-          for (int32_t y = 0; y < TownBuildingSize; ++y) {
-            for (int32_t x = 0; x < TownBuildingSize; ++x) {
-              const gf::Vec2I position = { x, y };
-              const char16_t part = compute_town_building_part(plan, position, building.direction);
-              const BuildingPartType type = building_part_type(part);
+            if (building.type == BuildingType::Empty || building.type == BuildingType::None) {
+              continue;
+            }
 
-              const gf::Vec2I map_position = town.position + block_position * (TownBuildingSize + StreetSize) + position;
+            const TownBuildingPlan& plan = compute_town_building_plan(building.type);
 
-              gf::ConsoleStyle style;
-              style.color = building_style(type);
-              style.effect = gf::ConsoleEffect::set();
+            for (int32_t y = 0; y < TownBuildingSize; ++y) {
+              for (int32_t x = 0; x < TownBuildingSize; ++x) {
+                const gf::Vec2I position = { x, y };
+                const gf::Vec2I map_position = town.position + block_position * (TownBuildingSize + StreetSize) + position;
 
-              gf::console_write_picture(ground.console, map_position, part, style);
+                if (!area.contains(map_position)) {
+                  continue;
+                }
 
-              switch (type) {
-                case BuildingPartType::None:
-                case BuildingPartType::Outside:
-                  // nothing to do
-                  break;
-                case BuildingPartType::Furniture:
-                case BuildingPartType::Wall:
-                  ground.background(map_position).properties.reset(RuntimeMapCellProperty::Walkable);
-                  break;
+                const char16_t part = compute_town_building_part(plan, position, building.direction);
+                function(map_position, part, building_part_type(part));
               }
             }
           }
         }
       }
-    }
 
-    for (const LocalityState& locality : state.map.localities) {
-      const LocalityBuildingPlan& plan = compute_locality_building_plan(locality.type, locality.number);
-      const gf::Vec2I base_position = locality.position - LocalityRadius;
+      for (const LocalityState& locality : state.map.localities) {
+        const gf::Vec2I base_position = locality.position - LocalityRadius;
+        const gf::RectI locality_space = gf::RectI::from_position_size(base_position, { LocalityDiameter, LocalityDiameter });
 
-      for (int32_t y = 0; y < LocalityDiameter; ++y) {
-        for (int32_t x = 0; x < LocalityDiameter; ++x) {
-          const gf::Vec2I position = { x, y };
-          const char16_t part = compute_locality_building_part(plan, position, locality.direction);
-          const BuildingPartType type = building_part_type(part);
+        if (!locality_space.intersection(area)) {
+          continue;
+        }
 
-          const gf::Vec2I map_position = base_position + position;
+        const LocalityBuildingPlan& plan = compute_locality_building_plan(locality.type, locality.number);
 
-          if (type != BuildingPartType::Outside) {
-            gf::ConsoleStyle style;
-            style.color = building_style(type);
-            style.effect = gf::ConsoleEffect::set();
+        for (int32_t y = 0; y < LocalityDiameter; ++y) {
+          for (int32_t x = 0; x < LocalityDiameter; ++x) {
+            const gf::Vec2I position = { x, y };
+            const gf::Vec2I map_position = base_position + position;
 
-            gf::console_write_picture(ground.console, map_position, part, style);
-          } else {
-            assert(part == u'.');
-          }
+            if (!area.contains(map_position)) {
+              continue;
+            }
+
+            const char16_t part = compute_locality_building_part(plan, position, locality.direction);
+            const BuildingPartType type = building_part_type(part);
 
-          switch (type) {
-            case BuildingPartType::None:
-            case BuildingPartType::Outside:
-              // nothing to do
-              break;
-            case BuildingPartType::Furniture:
-            case BuildingPartType::Wall:
-              ground.background(map_position).properties.reset(RuntimeMapCellProperty::Walkable);
-              break;
+            // the outside of a locality keeps the ground
+            if (type != BuildingPartType::Outside) {
+              function(map_position, part, type);
+            } else {
+              assert(part == u'.');
+            }
           }
         }
       }
     }
 
+    void bind_buildings_chunk(const WorldState& state, gf::Console& console, gf::RectI area)
+    {
+      for_each_building_part(state, area, [&](gf::Vec2I map_position, char16_t part, BuildingPartType type) {
+        gf::ConsoleStyle style;
+        style.color = building_style(type);
+        style.effect = gf::ConsoleEffect::set();
+
+        gf::console_write_picture(console, map_position - area.position(), part, style);
+      });
+    }
+
+  }
+
+  void MapRuntime::bind_buildings(const WorldState& state, WorkerPool& pool)
+  {
+    pool.parallel_for(compute_band_count(ground), [&](std::size_t band) {
+      for_each_building_part(state, compute_band(ground, band), [this](gf::Vec2I map_position, [[maybe_unused]] char16_t part, BuildingPartType type) {
+        switch (type) {
+          case BuildingPartType::None:
+          case BuildingPartType::Outside:
+            // nothing to do
+            break;
+          case BuildingPartType::Furniture:
+          case BuildingPartType::Wall:
+            ground.background(map_position).properties.reset(RuntimeMapCellProperty::Walkable);
+            break;
+        }
+      });
+    });
+  }
+
+  void MapRuntime::bind_chunk(Floor floor, gf::Vec2I chunk)
+  {
+    assert(m_state != nullptr);
+    const WorldState& state = *m_state;
+
+    FloorMap& map = from_floor(floor);
+    const gf::RectI area = map.chunks.area(chunk);
+    const std::size_t index = map.chunks.index(chunk);
+
+    if (floor == Floor::Underground) {
+      if (state.map.underground.chunk_filled(chunk)) {
+        map.consoles[index] = m_rock_console;
+        return;
+      }
+
+      auto console = std::make_shared<gf::Console>(area.size());
+      bind_floor_chunk(state.map.underground, *console, area, Appearance{ &m_streams, WorldGenerationStep::MapUnderground });
+      map.consoles[index] = std::move(console);
+      return;
+    }
+
+    auto console = std::make_shared<gf::Console>(area.size());
+    bind_floor_chunk(state.map.ground, *console, area, Appearance{ &m_streams, WorldGenerationStep::MapGround });
+    bind_railway_chunk(state, *console, area, m_railway_chunks[index]);
+    bind_roads_chunk(state, *console, area, m_road_chunks[index], Appearance{ &m_streams, WorldGenerationStep::MapRoads });
+    bind_towns_chunk(state, *console, area, Appearance{ &m_streams, WorldGenerationStep::MapTowns });
+    bind_buildings_chunk(state, *console, area);
+    map.consoles[index] = std::move(console);
   }
 
   namespace {
@@ -668,102 +1129,151 @@ namespace fw {
 
   namespace {
 
-    Minimap compute_base_minimap(const BackgroundMap& state, int factor) {
-      /*
-       * console
-       */
-
-      gf::Console console(WorldSize / factor);
+    /*
+     * The minimaps of a floor are a pyramid. The finest level is computed from
+     * the map, then each level is computed from the previous one, a node
+     * being the sum of four nodes of the previous level. A node keeps the
+     * histogram of the biomes, the number of explored cells and the overlays
+     * of its cells, so that the levels are exactly the same as if they were
+     * computed from the map.
+     */
+
+    constexpr int GroundMinimapFactor = 4;
+    constexpr int UndergroundMinimapFactor = 2;
+
+    struct MinimapNode {
+      std::array<uint16_t, MapCellBiomeCount> biomes = {};
+      uint16_t explored = 0;
+      bool water = false; // a cell of water surrounded by water
+      bool road = false;
+    };
 
-      // base colors
+    static_assert(gf::square(GroundMinimapFactor << (MinimapCount - 1)) <= std::numeric_limits<uint16_t>::max());
 
-      for (const gf::Vec2I position : gf::position_range(console.size())) {
-        gf::Color color = gf::Transparent;
+    using MinimapLevel = gf::Array2D<MinimapNode>;
 
-        std::array<int, MapCellBiomeCount> count = { };
+    template<typename Map>
+    bool is_inner_water(const Map& state, gf::Vec2I position)
+    {
+      for (int i = -1; i <= +1; ++i) {
+        for (int j = -1; j <= +1; ++j) {
+          const gf::Vec2I neighbor = position + gf::vec(i, j);
 
-        for (const gf::Vec2I offset : gf::position_range({ factor, factor })) {
-          gf::Vec2I origin_position = position * factor + offset;
-          const MapCellBiome region = state(origin_position).region;
-          const std::size_t index = static_cast<std::size_t>(region);
-          assert(index < count.size());
-          ++count[index];
+          if (state.valid(neighbor) && state(neighbor).decoration != MapCellDecoration::Water) {
+            return false;
+          }
         }
+      }
 
-        const auto iterator = std::max_element(std::begin(count), std::end(count));
-        const std::ptrdiff_t index = iterator - std::begin(count);
-        assert(0 <= index && std::size_t(index) < count.size());
-        const MapCellBiome region = static_cast<MapCellBiome>(index);
+      return true;
+    }
 
-        switch (region) {
-          case MapCellBiome::None:
-            color = gf::Transparent;
-            break;
-          case MapCellBiome::Prairie:
-            color = PrairieColor;
-            break;
-          case MapCellBiome::Desert:
-            color = DesertColor;
-            break;
-          case MapCellBiome::Forest:
-            color = ForestColor;
-            break;
-          case MapCellBiome::Mountain:
-            color = MountainColor;
-            break;
-          case MapCellBiome::Underground:
-            color = DirtColor;
-            break;
-          case MapCellBiome::Building:
-            color = StreetColor; // TODO
-            break;
-        }
+    template<typename Map>
+    MinimapLevel compute_finest_minimap_level(const Map& state, int factor, WorkerPool& pool)
+    {
+      MinimapLevel level(WorldSize / factor);
 
+      pool.parallel_for(static_cast<std::size_t>(level.size().h), [&](std::size_t row) {
+        for (int32_t x = 0; x < level.size().w; ++x) {
+          const gf::Vec2I position = { x, static_cast<int32_t>(row) };
+          MinimapNode& node = level(position);
 
-        gf::console_write_background(console, position, color);
-      }
+          for (const gf::Vec2I offset : gf::position_range({ factor, factor })) {
+            const gf::Vec2I origin_position = position * factor + offset;
+            const MapCell& cell = state(origin_position);
+
+            const std::size_t index = static_cast<std::size_t>(cell.region);
+            assert(index < node.biomes.size());
+            ++node.biomes[index];
+
+            if (cell.explored()) {
+              ++node.explored;
+            }
+
+            if (cell.decoration == MapCellDecoration::Water && !node.water) {
+              node.water = is_inner_water(state, origin_position);
+            }
+          }
+        }
+      });
 
-      /*
-       * explored
-       */
+      return level;
+    }
 
-      gf::Array2D<float> explored(WorldSize / factor);
+    MinimapLevel compute_coarser_minimap_level(const MinimapLevel& finer, WorkerPool& pool)
+    {
+      MinimapLevel level(finer.size() / 2);
 
-      for (const gf::Vec2I position : gf::position_range(explored.size())) {
-        int count = 0;
+      pool.parallel_for(static_cast<std::size_t>(level.size().h), [&](std::size_t row) {
+        for (int32_t x = 0; x < level.size().w; ++x) {
+          const gf::Vec2I position = { x, static_cast<int32_t>(row) };
+          MinimapNode& node = level(position);
 
-        for (const gf::Vec2I offset : gf::position_range({ factor, factor })) {
-          gf::Vec2I origin_position = position * factor + offset;
+          for (const gf::Vec2I offset : gf::position_range({ 2, 2 })) {
+            const MinimapNode& child = finer(position * 2 + offset);
 
-          if (state(origin_position).explored()) {
-            ++count;
+            for (std::size_t i = 0; i < MapCellBiomeCount; ++i) {
+              node.biomes[i] += child.biomes[i];
+            }
+
+            node.explored += child.explored;
+            node.water = node.water || child.water;
+            node.road = node.road || child.road;
           }
         }
+      });
 
-        explored(position) = static_cast<float>(count) / static_cast<float>(gf::square(factor));
+      return level;
+    }
+
+    gf::Color compute_minimap_color(MapCellBiome region)
+    {
+      switch (region) {
+        case MapCellBiome::None:
+          return gf::Transparent;
+        case MapCellBiome::Prairie:
+          return PrairieColor;
+        case MapCellBiome::Desert:
+          return DesertColor;
+        case MapCellBiome::Forest:
+          return ForestColor;
+        case MapCellBiome::Mountain:
+          return MountainColor;
+        case MapCellBiome::Underground:
+          return DirtColor;
+        case MapCellBiome::Building:
+          return StreetColor; // TODO
       }
 
-      return { console, explored, factor };
+      assert(false);
+      return gf::Transparent;
     }
 
-    Minimap compute_ground_minimap(const WorldState& state, int factor) {
-      const BackgroundMap& ground = state.map.ground;
+    Minimap compute_base_minimap(const MinimapLevel& level, int factor, WorkerPool& pool)
+    {
+      gf::Console console(level.size());
+      gf::Array2D<float> explored(level.size());
 
-      Minimap minimap = compute_base_minimap(ground, factor);
+      pool.parallel_for(static_cast<std::size_t>(level.size().h), [&](std::size_t row) {
+        for (int32_t x = 0; x < level.size().w; ++x) {
+          const gf::Vec2I position = { x, static_cast<int32_t>(row) };
+          const MinimapNode& node = level(position);
 
-      // towns
+          // the first biome in case of a tie
+          const auto iterator = std::max_element(node.biomes.begin(), node.biomes.end());
+          const MapCellBiome region = static_cast<MapCellBiome>(iterator - node.biomes.begin());
+          gf::console_write_background(console, position, compute_minimap_color(region));
 
-      // for (const TownState& town : state.map.towns) {
-      //   const gf::RectI town_space = gf::RectI::from_position_size(town.position, { TownDiameter, TownDiameter });
-      //
-      //   for (const gf::Vec2I position : gf::rectangle_range(town_space)) {
-      //     minimap.set_background(position / factor, StreetColor);
-      //   }
-      // }
+          explored(position) = static_cast<float>(node.explored) / static_cast<float>(gf::square(factor));
+        }
+      });
 
-      // train
+      return { console, explored, factor };
+    }
 
-      const std::vector<gf::Vec2I>& railway = state.network.railway;
+    // the railway on a level from the railway on the previous level (or the map)
+    std::vector<gf::Vec2I> compute_minimap_railway(const std::vector<gf::Vec2I>& railway, int factor)
+    {
       std::vector<gf::Vec2I> minimap_railway;
 
       for (const gf::Vec2I position : railway) {
@@ -779,6 +1289,23 @@ namespace fw {
         minimap_railway.pop_back();
       }
 
+      return minimap_railway;
+    }
+
+    void add_ground_overlays(Minimap& minimap, const MinimapLevel& level, const std::vector<gf::Vec2I>& minimap_railway)
+    {
+      // towns
+
+      // for (const TownState& town : state.map.towns) {
+      //   const gf::RectI town_space = gf::RectI::from_position_size(town.position, { TownDiameter, TownDiameter });
+      //
+      //   for (const gf::Vec2I position : gf::rectangle_range(town_space)) {
+      //     minimap.set_background(position / factor, StreetColor);
+      //   }
+      // }
+
+      // train
+
       for (const auto [ index, position ] : gf::enumerate(minimap_railway)) {
         const std::size_t index_before = (index + minimap_railway.size() - 1) % minimap_railway.size();
         const gf::Vec2I position_before = minimap_railway[index_before];
@@ -793,66 +1320,73 @@ namespace fw {
         gf::console_write_picture(minimap.console, position, picture, gf::Black);
       }
 
-      // roads
-
-      std::vector<gf::Vec2I> minimap_roads;
+      // roads, then river
 
-      for (const gf::Vec2I position : state.network.roads) {
-        minimap_roads.push_back(position / factor);
+      for (const gf::Vec2I position : level.position_range()) {
+        if (level(position).road) {
+          const gf::Color background = minimap.console(position).parts[0].background; // TODO
+          gf::console_write_background(minimap.console, position, gf::darker(background, 0.2f / minimap.factor));
+        }
       }
 
-      std::sort(minimap_roads.begin(), minimap_roads.end(), [](gf::Vec2I lhs, gf::Vec2I rhs) {
-        return std::tie(lhs.x, lhs.y) < std::tie(rhs.x, rhs.y);
-      });
+      for (const gf::Vec2I position : level.position_range()) {
+        if (level(position).water) {
+          gf::console_write_background(minimap.console, position, gf::Azure);
+        }
+      }
+    }
 
-      minimap_roads.erase(std::unique(minimap_roads.begin(), minimap_roads.end()), minimap_roads.end());
+    void compute_ground_minimaps(const WorldState& state, FloorMap& map, WorkerPool& pool)
+    {
+      int factor = GroundMinimapFactor;
+      MinimapLevel level = compute_finest_minimap_level(state.map.ground, factor, pool);
 
-      for (const gf::Vec2I position : minimap_roads) {
-        const gf::Color background = minimap.console(position).parts[0].background; // TODO
-        gf::console_write_background(minimap.console, position, gf::darker(background, 0.2f / factor));
+      for (const gf::Vec2I position : state.network.compute_road_points()) {
+        level(position / factor).road = true;
       }
 
-      // river
+      std::vector<gf::Vec2I> minimap_railway = compute_minimap_railway(state.network.railway, factor);
 
-      for (const gf::Vec2I position : ground.position_range()) {
-        if (ground(position).decoration != MapCellDecoration::Water) {
-          continue;
+      for (std::size_t i = 0; i < MinimapCount; ++i) {
+        if (i > 0) {
+          level = compute_coarser_minimap_level(level, pool);
+          minimap_railway = compute_minimap_railway(minimap_railway, 2);
+          factor *= 2;
         }
 
-        std::size_t count = 0;
+        Minimap minimap = compute_base_minimap(level, factor, pool);
+        add_ground_overlays(minimap, level, minimap_railway);
+        map.minimaps[i] = std::move(minimap);
+      }
+    }
 
-        for (gf::Vec2I neighbor : ground.compute_8_neighbors_range(position)) {
-          if (ground(neighbor).decoration != MapCellDecoration::Water) {
-            ++count;
-            break;
-          }
-        }
+    void compute_underground_minimaps(const WorldState& state, FloorMap& map, WorkerPool& pool)
+    {
+      int factor = UndergroundMinimapFactor;
+      MinimapLevel level = compute_finest_minimap_level(state.map.underground, factor, pool);
 
-        if (count == 0) {
-          gf::console_write_background(minimap.console, position / factor, gf::Azure);
+      for (std::size_t i = 0; i < MinimapCount; ++i) {
+        if (i > 0) {
+          level = compute_coarser_minimap_level(level, pool);
+          factor *= 2;
         }
-      }
-
-      return minimap;
-    }
 
-    Minimap compute_underground_minimap(const WorldState& state, int factor) {
-      return compute_base_minimap(state.map.underground, factor);
+        map.minimaps[i] = compute_base_minimap(level, factor, pool);
+      }
     }
 
   }
 
-  void MapRuntime::bind_minimaps(const WorldState& state)
+  void MapRuntime::bind_minimaps(const WorldState& state, WorkerPool& pool)
   {
-    ground.minimaps[0] = compute_ground_minimap(state, 4);
-    ground.minimaps[1] = compute_ground_minimap(state, 8);
-    ground.minimaps[2] = compute_ground_minimap(state, 16);
-    ground.minimaps[3] = compute_ground_minimap(state, 32);
-
-    underground.minimaps[0] = compute_underground_minimap(state, 2);
-    underground.minimaps[1] = compute_underground_minimap(state, 4);
-    underground.minimaps[2] = compute_underground_minimap(state, 8);
-    underground.minimaps[3] = compute_underground_minimap(state, 16);
+    // the floors are independent, the levels of a floor are computed one after the other
+    pool.parallel_for(2, [&](std::size_t floor) {
+      if (floor == 0) {
+        compute_ground_minimaps(state, ground, pool);
+      } else {
+        compute_underground_minimaps(state, underground, pool);
+      }
+    });
   }
 
 }
@@ -4,18 +4,25 @@
 #include <cstdint>
 
 #include <array>
+#include <memory>
+#include <stop_token>
+#include <thread>
+#include <vector>
 
 #include <gf2/core/Array2D.h>
+#include <gf2/core/Color.h>
 #include <gf2/core/Console.h>
 #include <gf2/core/Grids.h>
-#include <gf2/core/Random.h>
 
 #include "Index.h"
 #include "Location.h"
+#include "MapChunks.h"
 #include "MapFloor.h"
+#include "RandomStreams.h"
 #include "WorldGenerationStep.h"
 
 namespace fw {
+  class WorkerPool;
   struct WorldState;
 
   constexpr std::size_t MinimapCount = 4;
@@ -57,18 +64,28 @@ namespace fw {
     FloorMap() = default;
 
     explicit FloorMap(gf::Vec2I size)
-    : console(size)
-    , background(size, { gf::All })
+    : background(size, { gf::All })
     , reverse(size)
+    , chunks(size)
+    , consoles(static_cast<std::size_t>(chunks.count().w) * static_cast<std::size_t>(chunks.count().h))
+    , last_uses(consoles.size(), 0)
     {
     }
 
-    gf::Console console;
     gf::Array2D<RuntimeMapCell> background;
     gf::Array2D<ReverseMapCell> reverse;
+    MapChunks chunks;
+    // one console per chunk, bound lazily (see MapRuntime::bind_view()), the chunks of rock share their console
+    std::vector<std::shared_ptr<const gf::Console>> consoles;
+    // the last view of each chunk, the least recently used consoles are released
+    std::vector<uint64_t> last_uses;
 
     std::array<Minimap, MinimapCount> minimaps;
 
+    // the chunks of the view must be bound
+    void blit_to(gf::Console& console, gf::RectI view, gf::Vec2I destination) const;
+    gf::Color background_color(gf::Vec2I position) const;
+
     void update_minimap_explored(const std::vector<gf::Vec2I>& explored);
   };
 
@@ -79,19 +96,43 @@ namespace fw {
     const FloorMap& from_floor(Floor floor) const;
     FloorMap& from_floor(Floor floor);
 
-    void bind(const WorldState& state, gf::Random* random, WorldGenerationAnalysis& analysis);
+    // the global data, the console around the hero and then the rest of the console in the background
+    void bind(const WorldState& state, WorldGenerationAnalysis& analysis, std::size_t thread_count = 0);
+
+    // the console of the view is bound when the function returns, the consoles that have not been viewed for a long time are released
+    void bind_view(Floor floor, gf::RectI view);
+    // must be called before the state changes
+    void stop_binding();
+    // after the state has changed, around the hero
+    void resume_binding();
+    // after a cave has been dug in the area of the underground, the binding of the chunks is restarted
+    void bind_cave(const WorldState& state, gf::RectI area);
 
-    void bind_ground(const WorldState& state, gf::Random* random);
-    void bind_underground(const WorldState& state, gf::Random* random);
-    void bind_railway(const WorldState& state);
-    void bind_roads(const WorldState& state, gf::Random* random);
-    void bind_towns(const WorldState& state, gf::Random* random);
+    void bind_ground(const WorldState& state, WorkerPool& pool);
+    void bind_underground(const WorldState& state, WorkerPool& pool);
+    void bind_railway(const WorldState& state, WorkerPool& pool);
+    void bind_roads(const WorldState& state, WorkerPool& pool);
 
     void blur(const WorldState& state);
 
-    void bind_buildings(const WorldState& state);
+    void bind_buildings(const WorldState& state, WorkerPool& pool);
+
+    void bind_minimaps(const WorldState& state, WorkerPool& pool);
+
+  private:
+    void bind_chunk(Floor floor, gf::Vec2I chunk);
+    void warm_up_chunks(std::stop_token token, Location origin);
+    void start_binding(Location origin);
+    void evict_chunks(FloorMap& map, uint64_t current_use);
 
-    void bind_minimaps(const WorldState& state);
+    const WorldState* m_state = nullptr;
+    RandomStreams m_streams;
+    std::vector<std::vector<uint32_t>> m_railway_chunks; // the railway indices near each ground chunk
+    std::vector<std::vector<gf::Vec2I>> m_road_chunks; // the road points near each ground chunk
+    std::shared_ptr<const gf::Console> m_rock_console; // for the chunks of the underground that are only rock
+    uint64_t m_uses = 0; // the number of calls to bind_view()
+    Location m_warm_up_origin; // in chunks
+    std::jthread m_binder; // last, so that it is stopped first
   };
 
 }
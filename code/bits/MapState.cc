@@ -1,6 +1,11 @@
 #include "MapState.h"
 
+#include <cassert>
+
+#include <utility>
+
 #include <gf2/core/FieldOfVision.h>
+#include <gf2/core/Range.h>
 
 #include "MapCell.h"
 #include "Settings.h"
@@ -32,34 +37,99 @@ namespace fw {
     return explored;
   }
 
-  BackgroundMap& MapState::from_floor(Floor floor)
+  namespace {
+
+    gf::RectI compute_hero_vision(gf::Vec2I position)
+    {
+      return gf::RectI::from_center_size(position, { 2 * HeroVisionRange + 1, 2 * HeroVisionRange + 1 });
+    }
+
+  }
+
+  void clear_visible(UndergroundMap& map)
+  {
+    // the cells of the fill chunk have never been visible
+    map.for_each_allocated_cell([](MapCell& cell) {
+      cell.properties.reset(MapCellProperty::Visible);
+    });
+  }
+
+  std::vector<gf::Vec2I> compute_hero_fov(gf::Vec2I position, UndergroundMap& state_map)
+  {
+    std::vector<gf::Vec2I> explored;
+
+    clear_visible(state_map);
+
+    // the field of vision is computed on a copy of the neighborhood, only the cells that are seen are allocated
+    const gf::RectI vision = compute_hero_vision(position);
+    const gf::RectI window = gf::RectI::from_size(state_map.size()).intersection(vision).value_or(gf::RectI::from_position_size(position, { 1, 1 }));
+
+    BackgroundMap neighborhood(window.size());
+
+    for (const gf::Vec2I offset : neighborhood.position_range()) {
+      neighborhood(offset) = std::as_const(state_map)(window.position() + offset);
+    }
+
+    gf::compute_symmetric_shadowcasting(neighborhood, neighborhood, position - window.position(), HeroVisionRange, [&](gf::Vec2I offset, [[maybe_unused]] MapCell& neighborhood_cell) {
+      const gf::Vec2I cell_position = window.position() + offset;
+      MapCell& cell = state_map(cell_position);
+      cell.properties.set(MapCellProperty::Visible);
+
+      if (!cell.properties.test(MapCellProperty::Explored)) {
+        explored.push_back(cell_position);
+        cell.properties.set(MapCellProperty::Explored);
+      }
+    });
+
+    return explored;
+  }
+
+  bool hero_fov_shares_chunks(gf::Vec2I position, const UndergroundMap& state_map)
   {
-    switch (floor) {
+    return state_map.shares_chunks(compute_hero_vision(position));
+  }
+
+  std::vector<gf::Vec2I> compute_hero_fov(Location location, MapState& state)
+  {
+    switch (location.floor) {
       case Floor::Underground:
-        return underground;
+        return compute_hero_fov(location.position, state.underground);
       case Floor::Ground:
-        return ground;
+        return compute_hero_fov(location.position, state.ground);
       case Floor::Upstairs:
-        return ground; // TODO: upstairs
+        return compute_hero_fov(location.position, state.ground); // TODO: upstairs
     }
 
     assert(false);
-    return ground;
+    return {};
   }
 
-  const BackgroundMap& MapState::from_floor(Floor floor) const
+  const MapCell& MapState::cell(Location location) const
   {
-    switch (floor) {
+    switch (location.floor) {
       case Floor::Underground:
-        return underground;
+        return underground(location.position);
       case Floor::Ground:
-        return ground;
+        return ground(location.position);
       case Floor::Upstairs:
-        return ground; // TODO: upstairs
+        return ground(location.position); // TODO: upstairs
     }
 
     assert(false);
-    return ground;
+    return ground(location.position);
+  }
+
+  uint32_t MapState::find_cave(gf::Vec2I entrance) const
+  {
+    for (const auto [ index, cave ] : gf::enumerate(caves)) {
+      for (const CaveAccess& access : cave.accesses) {
+        if (access.entrance == entrance) {
+          return static_cast<uint32_t>(index);
+        }
+      }
+    }
+
+    return NoIndex;
   }
 
 }
@@ -3,10 +3,15 @@
 
 #include <cstdint>
 
+#include <vector>
+
 #include <gf2/core/Array2D.h>
 #include <gf2/core/Direction.h>
 #include <gf2/core/TypeTraits.h>
 
+#include "ChunkedArray2D.h"
+#include "Index.h"
+#include "Location.h"
 #include "MapCell.h"
 #include "MapFloor.h"
 
@@ -98,25 +103,70 @@ namespace fw {
     return ar | state.position | state.type | state.number | state.direction;
   }
 
+  struct CaveAccess {
+    gf::Vec2I entrance; // FloorDown on the ground
+    gf::Vec2I exit; // FloorUp in the underground
+  };
+
+  template<typename Archive>
+  Archive& operator|(Archive& ar, gf::MaybeConst<CaveAccess, Archive>& access)
+  {
+    return ar | access.entrance | access.exit;
+  }
+
+  struct CaveTunnel {
+    gf::Vec2I from;
+    gf::Vec2I to;
+  };
+
+  template<typename Archive>
+  Archive& operator|(Archive& ar, gf::MaybeConst<CaveTunnel, Archive>& tunnel)
+  {
+    return ar | tunnel.from | tunnel.to;
+  }
+
+  // the caves of a mountain region, planned at the creation of the world and dug the first time an actor goes down
+  struct CaveState {
+    std::vector<CaveAccess> accesses;
+    std::vector<CaveTunnel> tunnels;
+    bool dug = false;
+  };
+
+  template<typename Archive>
+  Archive& operator|(Archive& ar, gf::MaybeConst<CaveState, Archive>& state)
+  {
+    return ar | state.accesses | state.tunnels | state.dug;
+  }
+
   using BackgroundMap = gf::Array2D<MapCell>;
+  // mostly rock, only the caves are allocated
+  using UndergroundMap = ChunkedArray2D<MapCell>;
 
   void clear_visible(BackgroundMap& map);
+  void clear_visible(UndergroundMap& map);
   std::vector<gf::Vec2I>  compute_hero_fov(gf::Vec2I position, BackgroundMap& state_map);
+  std::vector<gf::Vec2I>  compute_hero_fov(gf::Vec2I position, UndergroundMap& state_map);
+  // true if the field of vision copies some chunks of the underground, the map runtime must not bind meanwhile
+  bool hero_fov_shares_chunks(gf::Vec2I position, const UndergroundMap& state_map);
 
   struct MapState {
     BackgroundMap ground;
-    BackgroundMap underground;
+    UndergroundMap underground;
     std::array<TownState, TownsCount> towns;
     std::array<LocalityState, LocalityCount> localities;
+    std::vector<CaveState> caves;
 
-    BackgroundMap& from_floor(Floor floor);
-    const BackgroundMap& from_floor(Floor floor) const;
+    const MapCell& cell(Location location) const;
+    // the index of the cave with this entrance or NoIndex
+    uint32_t find_cave(gf::Vec2I entrance) const;
   };
 
+  std::vector<gf::Vec2I> compute_hero_fov(Location location, MapState& state);
+
   template<typename Archive>
   Archive& operator|(Archive& ar, gf::MaybeConst<MapState, Archive>& state)
   {
-    return ar | state.ground | state.underground | state.towns | state.localities;
+    return ar | state.ground | state.underground | state.towns | state.localities | state.caves;
   }
 
 }
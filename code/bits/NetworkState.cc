@@ -1 +1,22 @@
 #include "NetworkState.h"
+
+namespace fw {
+
+  std::vector<gf::Vec2I> NetworkState::compute_road_points() const
+  {
+    std::vector<gf::Vec2I> points;
+
+    for (const RoadNode& node : road_nodes) {
+      if (node.type == RoadNodeType::Crossroad) {
+        points.push_back(node.position);
+      }
+    }
+
+    for (const RoadSection& section : road_sections) {
+      points.insert(points.end(), section.points.begin(), section.points.end());
+    }
+
+    return points;
+  }
+
+}
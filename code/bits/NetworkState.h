@@ -23,17 +23,48 @@ namespace fw {
     return ar | state.index | state.stop_time;
   }
 
+  enum class RoadNodeType : uint8_t {
+    Place, // in a town or a locality, not drawn
+    Crossroad,
+  };
+
+  struct RoadNode {
+    gf::Vec2I position;
+    RoadNodeType type = RoadNodeType::Crossroad;
+  };
+
+  template<typename Archive>
+  Archive& operator|(Archive& ar, gf::MaybeConst<RoadNode, Archive>& node)
+  {
+    return ar | node.position | node.type;
+  }
+
+  struct RoadSection {
+    uint32_t origin; // index in road_nodes
+    uint32_t target; // index in road_nodes
+    std::vector<gf::Vec2I> points; // from origin to target, without the nodes and the points in the places
+  };
+
+  template<typename Archive>
+  Archive& operator|(Archive& ar, gf::MaybeConst<RoadSection, Archive>& section)
+  {
+    return ar | section.origin | section.target | section.points;
+  }
+
   struct NetworkState {
     std::vector<gf::Vec2I> railway;
     std::vector<StationState> stations;
 
-    std::vector<gf::Vec2I> roads;
+    std::vector<RoadNode> road_nodes;
+    std::vector<RoadSection> road_sections;
+
+    std::vector<gf::Vec2I> compute_road_points() const;
   };
 
   template<typename Archive>
   Archive& operator|(Archive& ar, gf::MaybeConst<NetworkState, Archive>& state)
   {
-    return ar | state.railway | state.stations | state.roads;
+    return ar | state.railway | state.stations | state.road_nodes | state.road_sections;
   }
 
 }
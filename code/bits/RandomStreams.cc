@@ -0,0 +1,39 @@
+#include "RandomStreams.h"
+
+#include <cstdlib>
+
+#include <charconv>
+#include <limits>
+#include <string_view>
+
+#include <gf2/core/Log.h>
+
+namespace fw {
+
+  gf::Random RandomStreams::stream(WorldGenerationStep step, uint64_t index) const
+  {
+    // a different key for the engine than for the first cell value
+    return gf::Random(combine(compute_key(step, index), ~m_seed));
+  }
+
+  uint64_t generate_seed(gf::Random* random)
+  {
+    // to replay a world
+    if (const char* variable = std::getenv("FARWESTRL_SEED"); variable != nullptr) {
+      const std::string_view value = variable;
+      uint64_t seed = 0;
+
+      if (auto [ end, error ] = std::from_chars(value.data(), value.data() + value.size(), seed); error == std::errc() && end == value.data() + value.size()) {
+        gf::Log::info("Seed from FARWESTRL_SEED: {}", seed);
+        return seed;
+      }
+
+      gf::Log::warning("Invalid FARWESTRL_SEED: '{}'", value);
+    }
+
+    const uint64_t seed = random->compute_uniform_integer(std::numeric_limits<uint64_t>::max());
+    gf::Log::info("Seed: {}", seed);
+    return seed;
+  }
+
+}
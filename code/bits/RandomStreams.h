@@ -0,0 +1,86 @@
+#ifndef FW_RANDOM_STREAMS_H
+#define FW_RANDOM_STREAMS_H
+
+#include <cstdint>
+
+#include <gf2/core/Random.h>
+#include <gf2/core/Vec2.h>
+
+#include "WorldGenerationStep.h"
+
+namespace fw {
+
+  /*
+   * Random streams derived from the seed of the world.
+   *
+   * A stream is identified by a step and an index (a row, a tile, a
+   * region...), so it does not depend on the other streams: the steps can run
+   * in any order or in parallel and give the same world for the same seed.
+   *
+   * For the values of a cell, there is also a counter-based generator that
+   * hashes the seed, the step, the position and a counter. It has no state, so
+   * the cells can be computed in any order.
+   */
+
+  class RandomStreams {
+  public:
+    RandomStreams() = default;
+
+    explicit RandomStreams(uint64_t seed)
+    : m_seed(seed)
+    {
+    }
+
+    uint64_t seed() const
+    {
+      return m_seed;
+    }
+
+    gf::Random stream(WorldGenerationStep step, uint64_t index = 0) const;
+
+    uint64_t compute_value(WorldGenerationStep step, gf::Vec2I position, uint64_t counter = 0) const
+    {
+      const uint64_t cell = (uint64_t(static_cast<uint32_t>(position.x)) << 32) | uint64_t(static_cast<uint32_t>(position.y));
+      return combine(combine(compute_key(step, cell), counter), m_seed);
+    }
+
+    // in [0, 1)
+    float compute_uniform_float(WorldGenerationStep step, gf::Vec2I position, uint64_t counter = 0) const
+    {
+      return static_cast<float>(compute_value(step, position, counter) >> 40) * 0x1.0p-24f;
+    }
+
+    bool compute_bernoulli(WorldGenerationStep step, gf::Vec2I position, double probability, uint64_t counter = 0) const
+    {
+      return compute_uniform_float(step, position, counter) < probability;
+    }
+
+  private:
+    // splitmix64 finalizer
+    static constexpr uint64_t mix(uint64_t value)
+    {
+      value += UINT64_C(0x9E3779B97F4A7C15);
+      value = (value ^ (value >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+      value = (value ^ (value >> 27)) * UINT64_C(0x94D049BB133111EB);
+      return value ^ (value >> 31);
+    }
+
+    static constexpr uint64_t combine(uint64_t key, uint64_t value)
+    {
+      return mix(key ^ mix(value));
+    }
+
+    uint64_t compute_key(WorldGenerationStep step, uint64_t index) const
+    {
+      return combine(combine(m_seed, static_cast<uint64_t>(step)), index);
+    }
+
+    uint64_t m_seed = 0;
+  };
+
+  // FARWESTRL_SEED if defined, a random seed otherwise
+  uint64_t generate_seed(gf::Random* random);
+
+}
+
+#endif // FW_RANDOM_STREAMS_H
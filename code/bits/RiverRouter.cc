@@ -0,0 +1,233 @@
+#include "RiverRouter.h"
+
+#include <cassert>
+#include <cmath>
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <queue>
+
+#include <gf2/core/Math.h>
+
+#include "WorkerPool.h"
+
+namespace fw {
+
+  namespace {
+
+    constexpr float Infinity = std::numeric_limits<float>::infinity();
+    constexpr uint8_t NoLink = 0xFF;
+
+    constexpr gf::Vec2I FourNeighbors[] = {
+      { 0, -1 }, { -1, 0 }, { +1, 0 }, { 0, +1 }
+    };
+
+    constexpr uint8_t opposite_link(uint8_t link)
+    {
+      return static_cast<uint8_t>(std::size(FourNeighbors) - 1 - link);
+    }
+
+    struct QueueItem {
+      float priority;
+      int32_t index;
+
+      bool operator>(const QueueItem& other) const
+      {
+        return priority > other.priority;
+      }
+    };
+
+    using MinQueue = std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>>;
+
+  }
+
+  RiverRouter::RiverRouter(const gf::Array2D<float>& altitude, const gf::Array2D<float>& moisture, const RiverCosts& costs, WorkerPool& pool)
+  : m_horizontal_slopes(altitude.size(), Infinity)
+  , m_vertical_slopes(altitude.size(), Infinity)
+  , m_factors(altitude.size(), 0)
+  {
+    assert(altitude.size() == moisture.size());
+    const gf::Vec2I size = altitude.size();
+
+    pool.parallel_for(static_cast<std::size_t>(size.h), [&](std::size_t row) {
+      const int32_t y = static_cast<int32_t>(row);
+
+      for (int32_t x = 0; x < size.w; ++x) {
+        const gf::Vec2I position = { x, y };
+        const float value = altitude(position);
+
+        if (x + 1 < size.w) {
+          m_horizontal_slopes(position) = 1.0f + costs.slope_factor * gf::square(value - altitude({ x + 1, y }));
+        }
+
+        if (y + 1 < size.h) {
+          m_vertical_slopes(position) = 1.0f + costs.slope_factor * gf::square(value - altitude({ x, y + 1 }));
+        }
+
+        const float cell_moisture = moisture(position);
+
+        if (cell_moisture < costs.min_moisture) {
+          m_factors(position) = 0;
+        } else if (cell_moisture < costs.low_moisture) {
+          m_factors(position) = costs.low_moisture_factor;
+        } else if (cell_moisture < costs.high_moisture) {
+          m_factors(position) = costs.high_moisture_factor;
+        } else {
+          m_factors(position) = 1;
+        }
+      }
+    });
+
+    const std::size_t cell_count = static_cast<std::size_t>(size.w) * static_cast<std::size_t>(size.h);
+
+    for (SearchSide* side : { &m_origin_side, &m_target_side }) {
+      side->costs.resize(cell_count, Infinity);
+      side->links.resize(cell_count, NoLink);
+    }
+  }
+
+  float RiverRouter::compute_step(gf::Vec2I from, gf::Vec2I to) const
+  {
+    assert(gf::manhattan_distance(from, to) == 1);
+    const gf::Vec2I min = { std::min(from.x, to.x), std::min(from.y, to.y) };
+    const float slope = from.y == to.y ? m_horizontal_slopes(min) : m_vertical_slopes(min);
+    return slope * static_cast<float>(m_factors(to));
+  }
+
+  std::vector<gf::Vec2I> RiverRouter::compute_route(gf::Vec2I origin, gf::Vec2I target)
+  {
+    if (!m_factors.valid(origin) || !m_factors.valid(target) || m_factors(target) == 0) {
+      return {};
+    }
+
+    const int32_t width = size().w;
+
+    auto index_of = [width](gf::Vec2I position) {
+      return position.y * width + position.x;
+    };
+
+    auto position_of = [width](int32_t index) {
+      return gf::Vec2I(index % width, index / width);
+    };
+
+    // balanced potentials, the potential of the target side is the opposite
+    auto potential = [origin, target](gf::Vec2I position) {
+      return 0.5f * static_cast<float>(gf::manhattan_distance(position, target) - gf::manhattan_distance(position, origin));
+    };
+
+    MinQueue origin_queue;
+    MinQueue target_queue;
+
+    auto visit = [&](SearchSide& side, MinQueue& queue, float sign, gf::Vec2I position, float cost, uint8_t link) {
+      const int32_t index = index_of(position);
+
+      if (side.costs[index] == Infinity) {
+        m_visited.push_back(index);
+      }
+
+      side.costs[index] = cost;
+      side.links[index] = link;
+      queue.push({ cost + sign * potential(position), index });
+    };
+
+    // removes the outdated items on the top
+    auto clean = [&](SearchSide& side, MinQueue& queue, float sign) {
+      while (!queue.empty() && queue.top().priority > side.costs[queue.top().index] + sign * potential(position_of(queue.top().index))) {
+        queue.pop();
+      }
+    };
+
+    visit(m_origin_side, origin_queue, +1.0f, origin, 0.0f, NoLink);
+    visit(m_target_side, target_queue, -1.0f, target, 0.0f, NoLink);
+
+    float best_cost = origin == target ? 0.0f : Infinity;
+    int32_t meeting = origin == target ? index_of(origin) : -1;
+
+    for (;;) {
+      clean(m_origin_side, origin_queue, +1.0f);
+      clean(m_target_side, target_queue, -1.0f);
+
+      if (origin_queue.empty() || target_queue.empty()) {
+        break;
+      }
+
+      if (origin_queue.top().priority + target_queue.top().priority >= best_cost) {
+        break;
+      }
+
+      // the side with less open cells is expanded
+      const bool forward = origin_queue.size() <= target_queue.size();
+      SearchSide& side = forward ? m_origin_side : m_target_side;
+      SearchSide& other_side = forward ? m_target_side : m_origin_side;
+      MinQueue& queue = forward ? origin_queue : target_queue;
+      const float sign = forward ? +1.0f : -1.0f;
+
+      const int32_t index = queue.top().index;
+      queue.pop();
+
+      const gf::Vec2I position = position_of(index);
+      const float cost = side.costs[index];
+
+      for (uint8_t link = 0; link < std::size(FourNeighbors); ++link) {
+        const gf::Vec2I neighbor = position + FourNeighbors[link];
+
+        if (!m_factors.valid(neighbor)) {
+          continue;
+        }
+
+        // the origin may be unwalkable
+        if (m_factors(neighbor) == 0 && (forward || neighbor != origin)) {
+          continue;
+        }
+
+        const float step = forward ? compute_step(position, neighbor) : compute_step(neighbor, position);
+        const float neighbor_cost = cost + step;
+        const int32_t neighbor_index = index_of(neighbor);
+
+        if (neighbor_cost >= side.costs[neighbor_index]) {
+          continue;
+        }
+
+        visit(side, queue, sign, neighbor, neighbor_cost, opposite_link(link));
+
+        if (const float total_cost = neighbor_cost + other_side.costs[neighbor_index]; total_cost < best_cost) {
+          best_cost = total_cost;
+          meeting = neighbor_index;
+        }
+      }
+    }
+
+    std::vector<gf::Vec2I> route;
+
+    if (meeting != -1) {
+      for (int32_t index = meeting; index != -1;) {
+        const gf::Vec2I position = position_of(index);
+        route.push_back(position);
+        const uint8_t link = m_origin_side.links[index];
+        index = link == NoLink ? -1 : index_of(position + FourNeighbors[link]);
+      }
+
+      std::reverse(route.begin(), route.end());
+
+      for (uint8_t link = m_target_side.links[meeting]; link != NoLink;) {
+        const gf::Vec2I position = route.back() + FourNeighbors[link];
+        route.push_back(position);
+        link = m_target_side.links[index_of(position)];
+      }
+
+      assert(route.front() == origin && route.back() == target);
+    }
+
+    for (const int32_t index : m_visited) {
+      for (SearchSide* side : { &m_origin_side, &m_target_side }) {
+        side->costs[index] = Infinity;
+        side->links[index] = NoLink;
+      }
+    }
+
+    m_visited.clear();
+    return route;
+  }
+
+}
@@ -0,0 +1,69 @@
+#ifndef FW_RIVER_ROUTER_H
+#define FW_RIVER_ROUTER_H
+
+#include <cstdint>
+
+#include <vector>
+
+#include <gf2/core/Array2D.h>
+#include <gf2/core/Vec2.h>
+
+namespace fw {
+  class WorkerPool;
+
+  struct RiverCosts {
+    float slope_factor = 1.0f;
+    float min_moisture = 0.0f; // below, the cell is not walkable
+    float low_moisture = 0.0f;
+    uint8_t low_moisture_factor = 1;
+    float high_moisture = 0.0f;
+    uint8_t high_moisture_factor = 1; // between low and high moisture
+  };
+
+  /*
+   * A router for the rivers on the orthogonal grid of the terrain.
+   *
+   * The cost of a step is (1 + slope_factor * slope²) multiplied by a factor
+   * that depends on the moisture of the destination. The slope costs of the
+   * horizontal and vertical edges and the moisture factors are computed once
+   * in the constructor. A route is searched with a bidirectional A* whose
+   * potentials are the average of the manhattan distances to both ends, which
+   * is admissible since a step costs at least 1. The buffers of the search are
+   * kept between the routes and only the visited cells are reset.
+   *
+   * Like gf::GridMap::compute_route(), the origin may be unwalkable but not
+   * the target.
+   */
+
+  class RiverRouter {
+  public:
+    RiverRouter(const gf::Array2D<float>& altitude, const gf::Array2D<float>& moisture, const RiverCosts& costs, WorkerPool& pool);
+
+    gf::Vec2I size() const
+    {
+      return m_factors.size();
+    }
+
+    // the route includes the origin and the target, empty if there is no route
+    std::vector<gf::Vec2I> compute_route(gf::Vec2I origin, gf::Vec2I target);
+
+  private:
+    struct SearchSide {
+      std::vector<float> costs;
+      std::vector<uint8_t> links; // the direction of the previous cell for the origin side, of the next cell for the target side
+    };
+
+    float compute_step(gf::Vec2I from, gf::Vec2I to) const;
+
+    gf::Array2D<float> m_horizontal_slopes; // between (x, y) and (x + 1, y)
+    gf::Array2D<float> m_vertical_slopes; // between (x, y) and (x, y + 1)
+    gf::Array2D<uint8_t> m_factors; // 0 if the cell is not walkable
+
+    SearchSide m_origin_side;
+    SearchSide m_target_side;
+    std::vector<int32_t> m_visited;
+  };
+
+}
+
+#endif // FW_RIVER_ROUTER_H
@@ -42,6 +42,9 @@ namespace fw {
    * Map
    */
 
+  // the size of the chunks of the maps that are bound or allocated lazily
+  constexpr int32_t MapChunkSize = 128;
+
   // map runtime
 
   constexpr double RoadColorProbability = 0.7;
@@ -0,0 +1,21 @@
+#include "SummedAreaTable.h"
+
+#include <algorithm>
+
+namespace fw {
+
+  uint32_t SummedAreaTable::count(gf::RectI area) const
+  {
+    const int32_t min_x = std::max(area.position().x, 0);
+    const int32_t min_y = std::max(area.position().y, 0);
+    const int32_t max_x = std::min(area.position().x + area.size().w, m_size.w);
+    const int32_t max_y = std::min(area.position().y + area.size().h, m_size.h);
+
+    if (min_x >= max_x || min_y >= max_y) {
+      return 0;
+    }
+
+    return sum(max_x, max_y) - sum(min_x, max_y) - sum(max_x, min_y) + sum(min_x, min_y);
+  }
+
+}
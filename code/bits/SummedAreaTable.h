@@ -0,0 +1,67 @@
+#ifndef FW_SUMMED_AREA_TABLE_H
+#define FW_SUMMED_AREA_TABLE_H
+
+#include <cstdint>
+
+#include <vector>
+
+#include <gf2/core/Rect.h>
+#include <gf2/core/Vec2.h>
+
+namespace fw {
+
+  // counts the cells that satisfy a predicate in any rectangle in constant time
+
+  class SummedAreaTable {
+  public:
+    SummedAreaTable() = default;
+
+    template<typename Predicate>
+    SummedAreaTable(gf::Vec2I size, Predicate predicate)
+    : m_size(size)
+    , m_sums(static_cast<std::size_t>(size.w + 1) * static_cast<std::size_t>(size.h + 1), 0)
+    {
+      for (int32_t y = 0; y < size.h; ++y) {
+        uint32_t row_sum = 0;
+
+        for (int32_t x = 0; x < size.w; ++x) {
+          if (predicate(gf::Vec2I(x, y))) {
+            ++row_sum;
+          }
+
+          sum(x + 1, y + 1) = sum(x + 1, y) + row_sum;
+        }
+      }
+    }
+
+    gf::Vec2I size() const
+    {
+      return m_size;
+    }
+
+    // the part of the area outside the table is ignored
+    uint32_t count(gf::RectI area) const;
+
+  private:
+    uint32_t& sum(int32_t x, int32_t y)
+    {
+      return m_sums[index(x, y)];
+    }
+
+    uint32_t sum(int32_t x, int32_t y) const
+    {
+      return m_sums[index(x, y)];
+    }
+
+    std::size_t index(int32_t x, int32_t y) const
+    {
+      return static_cast<std::size_t>(y) * static_cast<std::size_t>(m_size.w + 1) + static_cast<std::size_t>(x);
+    }
+
+    gf::Vec2I m_size = { 0, 0 };
+    std::vector<uint32_t> m_sums; // (size.w + 1) x (size.h + 1), the first row and column are zero
+  };
+
+}
+
+#endif // FW_SUMMED_AREA_TABLE_H
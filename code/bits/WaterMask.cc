@@ -0,0 +1,26 @@
+#include "WaterMask.h"
+
+#include <cassert>
+
+namespace fw {
+
+  WaterMask::WaterMask(const BackgroundMap& ground, int32_t factor)
+  : m_factor(factor)
+  , m_water(ground.size() / factor, 0)
+  {
+    assert(factor > 0);
+
+    for (const gf::Vec2I position : ground.position_range()) {
+      if (ground(position).decoration != MapCellDecoration::Water) {
+        continue;
+      }
+
+      const gf::Vec2I reduced_position = position / factor;
+
+      if (m_water.valid(reduced_position)) {
+        m_water(reduced_position) = 1;
+      }
+    }
+  }
+
+}
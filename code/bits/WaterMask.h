@@ -0,0 +1,46 @@
+#ifndef FW_WATER_MASK_H
+#define FW_WATER_MASK_H
+
+#include <cstdint>
+
+#include <gf2/core/Array2D.h>
+#include <gf2/core/Vec2.h>
+
+#include "MapState.h"
+
+namespace fw {
+
+  /*
+   * The water on a grid reduced by a factor. A reduced cell has water if any
+   * cell of its block has water.
+   */
+
+  class WaterMask {
+  public:
+    WaterMask() = default;
+    WaterMask(const BackgroundMap& ground, int32_t factor);
+
+    gf::Vec2I size() const
+    {
+      return m_water.size();
+    }
+
+    int32_t factor() const
+    {
+      return m_factor;
+    }
+
+    // in reduced coordinates
+    bool has_water(gf::Vec2I reduced_position) const
+    {
+      return m_water(reduced_position) != 0;
+    }
+
+  private:
+    int32_t m_factor = 1;
+    gf::Array2D<uint8_t> m_water;
+  };
+
+}
+
+#endif // FW_WATER_MASK_H
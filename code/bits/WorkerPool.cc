@@ -0,0 +1,122 @@
+#include "WorkerPool.h"
+
+#include <cassert>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+namespace fw {
+
+  namespace {
+
+    struct Batch {
+      std::size_t count = 0;
+      const std::function<void(std::size_t)>* function = nullptr;
+      std::atomic<std::size_t> next = 0;
+      std::atomic<std::size_t> finished = 0;
+
+      void process()
+      {
+        for (;;) {
+          const std::size_t index = next.fetch_add(1);
+
+          if (index >= count) {
+            return;
+          }
+
+          (*function)(index);
+
+          if (finished.fetch_add(1) + 1 == count) {
+            finished.notify_all();
+          }
+        }
+      }
+    };
+
+  }
+
+  WorkerPool::WorkerPool(std::size_t thread_count)
+  {
+    if (thread_count == 0) {
+      thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    m_threads.reserve(thread_count);
+
+    for (std::size_t i = 0; i < thread_count; ++i) {
+      m_threads.emplace_back([this](std::stop_token token) { run(token); });
+    }
+  }
+
+  WorkerPool::~WorkerPool()
+  {
+    for (std::jthread& thread : m_threads) {
+      thread.request_stop();
+    }
+
+    m_condition.notify_all();
+  }
+
+  void WorkerPool::parallel_for(std::size_t count, const std::function<void(std::size_t)>& function)
+  {
+    if (count == 0) {
+      return;
+    }
+
+    auto batch = std::make_shared<Batch>();
+    batch->count = count;
+    batch->function = &function;
+
+    // the helpers may start after the batch is over, they only touch the counters in that case
+    const std::size_t helpers = std::min(count, m_threads.size()) - 1;
+
+    for (std::size_t i = 0; i < helpers; ++i) {
+      push_job([batch]() { batch->process(); });
+    }
+
+    batch->process();
+
+    for (std::size_t finished = batch->finished.load(); finished < count; finished = batch->finished.load()) {
+      batch->finished.wait(finished);
+    }
+  }
+
+  void WorkerPool::submit(std::function<void()> job)
+  {
+    assert(job);
+    push_job(std::move(job));
+  }
+
+  void WorkerPool::run(std::stop_token token)
+  {
+    for (;;) {
+      std::function<void()> job;
+
+      {
+        std::unique_lock lock(m_mutex);
+
+        if (!m_condition.wait(lock, token, [this]() { return !m_jobs.empty(); })) {
+          return;
+        }
+
+        job = std::move(m_jobs.front());
+        m_jobs.pop_front();
+      }
+
+      assert(job);
+      job();
+    }
+  }
+
+  void WorkerPool::push_job(std::function<void()> job)
+  {
+    {
+      std::lock_guard lock(m_mutex);
+      m_jobs.push_back(std::move(job));
+    }
+
+    m_condition.notify_one();
+  }
+
+}
@@ -0,0 +1,49 @@
+#ifndef FW_WORKER_POOL_H
+#define FW_WORKER_POOL_H
+
+#include <cstddef>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace fw {
+
+  class WorkerPool {
+  public:
+    // 0 means one worker per hardware thread
+    explicit WorkerPool(std::size_t thread_count = 0);
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool(WorkerPool&&) = delete;
+    ~WorkerPool();
+
+    WorkerPool& operator=(const WorkerPool&) = delete;
+    WorkerPool& operator=(WorkerPool&&) = delete;
+
+    std::size_t thread_count() const
+    {
+      return m_threads.size();
+    }
+
+    // run function(i) for i in [0, count), the calling thread takes part in the work
+    void parallel_for(std::size_t count, const std::function<void(std::size_t)>& function);
+
+    // run the job on a worker, the job can submit other jobs or call parallel_for()
+    void submit(std::function<void()> job);
+
+  private:
+    void run(std::stop_token token);
+    void push_job(std::function<void()> job);
+
+    std::mutex m_mutex;
+    std::condition_variable_any m_condition;
+    std::deque<std::function<void()>> m_jobs;
+    std::vector<std::jthread> m_threads;
+  };
+
+}
+
+#endif // FW_WORKER_POOL_H
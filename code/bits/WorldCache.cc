@@ -0,0 +1,217 @@
+#include "WorldCache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <fstream>
+#include <iterator>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include <gf2/core/Clock.h>
+#include <gf2/core/Log.h>
+
+#include "WorldGeneration.h"
+#include "WorldState.h"
+
+namespace fw {
+
+  namespace {
+
+    constexpr std::string_view CacheExtension = ".world";
+    constexpr std::string_view TemporaryExtension = ".tmp";
+    // a temporary file older than that has been left by a store that did not finish
+    constexpr std::chrono::hours StaleTemporaryAge(1);
+
+    // FNV-1a
+
+    constexpr uint64_t HashOffset = UINT64_C(0xCBF29CE484222325);
+    constexpr uint64_t HashPrime = UINT64_C(0x100000001B3);
+
+    uint64_t hash_bytes(uint64_t hash, const char* bytes, std::size_t size)
+    {
+      for (std::size_t i = 0; i < size; ++i) {
+        hash ^= static_cast<uint8_t>(bytes[i]);
+        hash *= HashPrime;
+      }
+
+      return hash;
+    }
+
+    uint64_t hash_integer(uint64_t hash, uint64_t value)
+    {
+      for (int i = 0; i < 8; ++i) {
+        hash ^= (value >> (8 * i)) & 0xFF;
+        hash *= HashPrime;
+      }
+
+      return hash;
+    }
+
+    struct CacheEntry {
+      std::filesystem::path path;
+      std::filesystem::file_time_type time;
+      std::uintmax_t size;
+    };
+
+  }
+
+  WorldCache::WorldCache(std::filesystem::path directory, std::uintmax_t max_size)
+  : m_directory(std::move(directory))
+  , m_max_size(max_size)
+  {
+  }
+
+  uint64_t WorldCache::compute_key(uint64_t seed, const std::filesystem::path& datafile)
+  {
+    uint64_t key = HashOffset;
+    key = hash_integer(key, seed);
+    key = hash_integer(key, StateVersion);
+    key = hash_integer(key, GeneratorVersion);
+
+    std::ifstream file(datafile, std::ios::binary);
+    const std::vector<char> content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return hash_bytes(key, content.data(), content.size());
+  }
+
+  bool WorldCache::load(uint64_t key, WorldState& state)
+  {
+    const std::filesystem::path path = compute_path(key);
+    std::error_code error;
+
+    if (!std::filesystem::is_regular_file(path, error)) {
+      return false;
+    }
+
+    gf::Clock clock;
+
+    try {
+      state.load_from_file(path);
+    } catch (const std::exception& exception) {
+      // a truncated or corrupted file, the world is generated again
+      gf::Log::warning("Could not load the world from cache {}: {}", path.string(), exception.what());
+      std::filesystem::remove(path, error);
+      return false;
+    }
+
+    // the time of the file is the time of the last use
+    std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error);
+
+    gf::Log::info("World loaded in {:g}s from cache {}", clock.elapsed_time().as_seconds(), path.string());
+    return true;
+  }
+
+  void WorldCache::store(uint64_t key, const WorldState& state)
+  {
+    std::error_code error;
+    std::filesystem::create_directories(m_directory, error);
+
+    if (error) {
+      gf::Log::warning("Could not create the world cache {}: {}", m_directory.string(), error.message());
+      return;
+    }
+
+    const std::filesystem::path path = compute_path(key);
+
+    // another instance may load the world at the same time, so the file is renamed at the end
+    std::filesystem::path temporary = path;
+    temporary += TemporaryExtension;
+
+    try {
+      state.save_to_file(temporary);
+    } catch (const std::exception& exception) {
+      gf::Log::warning("Could not save the world in cache {}: {}", temporary.string(), exception.what());
+      std::filesystem::remove(temporary, error);
+      return;
+    }
+
+    // the streams do not report a failed write, at least the file must not be empty
+    if (const std::uintmax_t size = std::filesystem::file_size(temporary, error); error || size == 0) {
+      gf::Log::warning("Could not save the world in cache {}", temporary.string());
+      std::filesystem::remove(temporary, error);
+      return;
+    }
+
+    std::filesystem::rename(temporary, path, error);
+
+    if (error) {
+      gf::Log::warning("Could not store the world in cache {}: {}", path.string(), error.message());
+      std::filesystem::remove(temporary, error);
+      return;
+    }
+
+    evict();
+  }
+
+  std::future<void> WorldCache::store_copy(uint64_t key, WorldState state)
+  {
+    return std::async(std::launch::async, [this, key, state = std::move(state)]() {
+      store(key, state);
+    });
+  }
+
+  std::filesystem::path WorldCache::compute_path(uint64_t key) const
+  {
+    return m_directory / fmt::format("{:016x}{}", key, CacheExtension);
+  }
+
+  void WorldCache::evict()
+  {
+    std::vector<CacheEntry> entries;
+    std::uintmax_t total_size = 0;
+    std::error_code error;
+
+    const std::filesystem::file_time_type now = std::filesystem::file_time_type::clock::now();
+
+    for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(m_directory, error)) {
+      if (!entry.is_regular_file(error)) {
+        continue;
+      }
+
+      if (entry.path().extension() == TemporaryExtension) {
+        // another instance may be storing a world, only the old files are removed
+        if (const std::filesystem::file_time_type time = entry.last_write_time(error); !error && now - time > StaleTemporaryAge) {
+          std::filesystem::remove(entry.path(), error);
+          gf::Log::debug("World cache: {} removed", entry.path().string());
+        }
+
+        continue;
+      }
+
+      if (entry.path().extension() != CacheExtension) {
+        continue;
+      }
+
+      const std::uintmax_t size = entry.file_size(error);
+      const std::filesystem::file_time_type time = entry.last_write_time(error);
+
+      if (error) {
+        continue;
+      }
+
+      entries.push_back({ entry.path(), time, size });
+      total_size += size;
+    }
+
+    if (total_size <= m_max_size) {
+      return;
+    }
+
+    // least recently used first
+    std::sort(entries.begin(), entries.end(), [](const CacheEntry& lhs, const CacheEntry& rhs) {
+      return lhs.time < rhs.time;
+    });
+
+    // the last entry is the world that has just been stored, it is kept
+    for (std::size_t i = 0; i + 1 < entries.size() && total_size > m_max_size; ++i) {
+      if (std::filesystem::remove(entries[i].path, error)) {
+        gf::Log::debug("World cache: {} removed", entries[i].path.string());
+        total_size -= entries[i].size;
+      }
+    }
+  }
+
+}
@@ -0,0 +1,45 @@
+#ifndef FW_WORLD_CACHE_H
+#define FW_WORLD_CACHE_H
+
+#include <cstdint>
+
+#include <filesystem>
+#include <future>
+
+namespace fw {
+  struct WorldState;
+
+  /*
+   * A cache of generated worlds on disk.
+   *
+   * A world is stored in a file named after a key computed from the seed, the
+   * content of the data file and the versions of the state and the
+   * generator. The files that have not been used recently are removed when
+   * the cache is bigger than its maximum size.
+   */
+
+  class WorldCache {
+  public:
+    static constexpr std::uintmax_t DefaultMaxSize = 512 * 1024 * 1024;
+
+    explicit WorldCache(std::filesystem::path directory, std::uintmax_t max_size = DefaultMaxSize);
+
+    static uint64_t compute_key(uint64_t seed, const std::filesystem::path& datafile);
+
+    // false if the world is not in the cache
+    bool load(uint64_t key, WorldState& state);
+    void store(uint64_t key, const WorldState& state);
+    // the state changes with the first turn, so the cache gets a copy
+    std::future<void> store_copy(uint64_t key, WorldState state);
+
+  private:
+    std::filesystem::path compute_path(uint64_t key) const;
+    void evict();
+
+    std::filesystem::path m_directory;
+    std::uintmax_t m_max_size;
+  };
+
+}
+
+#endif // FW_WORLD_CACHE_H
@@ -1,10 +1,14 @@
 #include "WorldGeneration.h"
 
+#include <cmath>
 #include <cstdint>
 
 #include <algorithm>
-#include <queue>
+#include <bit>
+#include <limits>
 #include <string_view>
+#include <unordered_map>
+#include <utility>
 
 #include <gf2/core/Array2D.h>
 #include <gf2/core/Clock.h>
@@ -14,7 +18,6 @@
 #include <gf2/core/FieldOfVision.h>
 #include <gf2/core/Geometry.h>
 #include <gf2/core/GridMap.h>
-#include <gf2/core/Heightmap.h>
 #include <gf2/core/Log.h>
 #include <gf2/core/Noises.h>
 #include <gf2/core/ProcGen.h>
@@ -23,22 +26,29 @@
 #include "ActorData.h"
 #include "ActorGeneration.h"
 #include "ActorState.h"
+#include "BitGrid.h"
 #include "Colors.h"
 #include "Date.h"
+#include "DebugImageSink.h"
+#include "HierarchicalPathfinder.h"
 #include "ItemState.h"
 #include "MapBuilding.h"
 #include "MapCell.h"
 #include "MapCellBiome.h"
 #include "MapState.h"
+#include "RandomStreams.h"
+#include "RiverRouter.h"
 #include "Settings.h"
+#include "SummedAreaTable.h"
+#include "WaterMask.h"
+#include "WorkerPool.h"
 #include "WorldData.h"
+#include "WorldGenerationGraph.h"
 
 namespace fw {
 
   namespace {
 
-    constexpr bool Debug = true;
-
     constexpr double WorldNoiseScale = WorldBasicSize / 256.0;
 
     constexpr int32_t WorldPaddingSize = 150;
@@ -75,6 +85,11 @@ namespace fw {
     constexpr int32_t ReducedLocalityDiameter = LocalityDiameter / ReducedFactor;
     constexpr int32_t LocalityMinDistanceFromOther = 250;
 
+    constexpr int PlaceMaxRounds = 20;
+    constexpr std::size_t PlaceAttemptsPerPlace = 50;
+    constexpr int32_t PlaceDistanceRelaxation = 90; // in percent
+    constexpr int PlaceMaxSamplings = 3;
+
     constexpr std::size_t DayTime = 24 * 60 * 60;
     constexpr int32_t RailSpacing = 2;
 
@@ -100,7 +115,6 @@ namespace fw {
     };
 
     constexpr std::size_t SurfacePerCave = 2000;
-    constexpr std::size_t MaxCaveAccessTries = 20;
     constexpr int32_t CaveMinDistance = 10;
     constexpr int32_t CaveLinkDistance = 70;
 
@@ -124,7 +138,8 @@ namespace fw {
       Blocks,
     };
 
-    gf::Image compute_basic_image(const BackgroundMap& state, ImageType type = ImageType::Basic) {
+    template<typename Map>
+    gf::Image compute_basic_image(const Map& state, ImageType type = ImageType::Basic) {
       gf::Image image(WorldSize);
 
       for (const gf::Vec2I position : image.position_range()) {
@@ -196,85 +211,156 @@ namespace fw {
      *
      * The values are used many times in the process but are not kept in the
      * final state of the game.
+     *
+     * The map is computed by tiles on the worker pool. The arithmetic is the
+     * same as in gf::Heightmap (add_noise() then normalize()) so that the
+     * result does not depend on the number of threads.
      */
 
-    struct RawCell {
-      double altitude;
-      double moisture;
-    };
+    struct RawWorld {
+      RawWorld() = default;
 
-    using RawWorld = gf::Array2D<RawCell>;
+      RawWorld(gf::Vec2I size)
+      : altitude(size)
+      , moisture(size)
+      {
+      }
 
-    RawWorld generate_raw(gf::Random* random)
-    {
-      RawWorld raw(WorldSize);
+      gf::Vec2I size() const
+      {
+        return altitude.size();
+      }
 
-      gf::PerlinNoise2D altitude_noise(random, WorldNoiseScale);
-      gf::Heightmap altitude_heightmap(WorldSize);
-      altitude_heightmap.add_noise(&altitude_noise);
-      altitude_heightmap.normalize();
+      bool valid(gf::Vec2I position) const
+      {
+        return altitude.valid(position);
+      }
 
-      gf::PerlinNoise2D moisture_noise(random, WorldNoiseScale);
-      gf::Heightmap moisture_heightmap(WorldSize);
-      moisture_heightmap.add_noise(&moisture_noise);
-      moisture_heightmap.normalize();
+      auto position_range() const
+      {
+        return altitude.position_range();
+      }
 
-      for (const gf::Vec2I position : raw.position_range()) {
-        RawCell& cell = raw(position);
-        cell.altitude = altitude_heightmap.value(position);
-        cell.moisture = moisture_heightmap.value(position);
+      std::size_t index(gf::Vec2I position) const
+      {
+        return static_cast<std::size_t>(position.y) * static_cast<std::size_t>(altitude.size().w) + static_cast<std::size_t>(position.x);
+      }
 
-        double factor = 1.0;
+      // two separate planes so that the passes that only need one value do not load the other
+      gf::Array2D<float> altitude;
+      gf::Array2D<float> moisture;
+    };
 
-        if (position.x < WorldPaddingSize) {
-          factor *= double(position.x) / double (WorldPaddingSize);
-        } else if (position.x >= WorldSize.x - WorldPaddingSize) {
-          factor *= double(WorldSize.x - position.x - 1) / double (WorldPaddingSize);
-        }
+    constexpr int32_t TerrainTileSize = 256;
+    constexpr gf::Vec2I TerrainTileCount = WorldSize / TerrainTileSize;
+    static_assert(WorldBasicSize % TerrainTileSize == 0);
 
-        if (position.y < WorldPaddingSize) {
-          factor *= double(position.y) / double (WorldPaddingSize);
-        } else if (position.y >= WorldSize.y - WorldPaddingSize) {
-          factor *= double(WorldSize.y - 1 - position.y) / double (WorldPaddingSize);
-        }
+    struct TerrainRange {
+      double altitude_min = std::numeric_limits<double>::max();
+      double altitude_max = std::numeric_limits<double>::lowest();
+      double moisture_min = std::numeric_limits<double>::max();
+      double moisture_max = std::numeric_limits<double>::lowest();
 
-        cell.altitude = 1.0 - (1.0 - cell.altitude) * gf::ease_out_cubic(factor);
+      void merge(const TerrainRange& other)
+      {
+        altitude_min = std::min(altitude_min, other.altitude_min);
+        altitude_max = std::max(altitude_max, other.altitude_max);
+        moisture_min = std::min(moisture_min, other.moisture_min);
+        moisture_max = std::max(moisture_max, other.moisture_max);
       }
+    };
 
-      return raw;
+    gf::RectI compute_terrain_tile(std::size_t index)
+    {
+      const gf::Vec2I tile = { static_cast<int32_t>(index % TerrainTileCount.w), static_cast<int32_t>(index / TerrainTileCount.w) };
+      return gf::RectI::from_position_size(tile * TerrainTileSize, { TerrainTileSize, TerrainTileSize });
+    }
+
+    double compute_noise_value(gf::Noise2D* noise, gf::Vec2I position)
+    {
+      const double x = static_cast<double>(position.x) / static_cast<double>(WorldSize.w);
+      const double y = static_cast<double>(position.y) / static_cast<double>(WorldSize.h);
+      return noise->value(x, y);
     }
 
-    float distance_for_rivers(const RawWorld& raw, gf::Vec2I position, gf::Vec2I neighbor)
+    double compute_padding_factor(gf::Vec2I position)
     {
-      neighbor = gf::clamp(neighbor, { 0, 0 }, raw.size() - 1);
+      double factor = 1.0;
 
-      if (position == neighbor) {
-        return 1e10;
+      if (position.x < WorldPaddingSize) {
+        factor *= double(position.x) / double (WorldPaddingSize);
+      } else if (position.x >= WorldSize.x - WorldPaddingSize) {
+        factor *= double(WorldSize.x - position.x - 1) / double (WorldPaddingSize);
       }
 
-      const float distance = gf::euclidean_distance<float>(position, neighbor);
-      const float slope = static_cast<float>(std::abs(raw(position).altitude - raw(neighbor).altitude)) / distance;
+      if (position.y < WorldPaddingSize) {
+        factor *= double(position.y) / double (WorldPaddingSize);
+      } else if (position.y >= WorldSize.y - WorldPaddingSize) {
+        factor *= double(WorldSize.y - 1 - position.y) / double (WorldPaddingSize);
+      }
 
-      const float value = distance * (1 + RiverSlopeFactor * gf::square(slope));
+      return factor;
+    }
 
-      const double moisture = raw(neighbor).moisture;
+    RawWorld generate_raw(gf::Random* random, WorkerPool& pool)
+    {
+      RawWorld raw(WorldSize);
 
-      if (moisture < MoistureLoThreshold) {
-        return value * 10;
-      }
+      // the noises are created in the same order as before, evaluating them does not touch the random engine
+      gf::PerlinNoise2D altitude_noise(random, WorldNoiseScale);
+      gf::PerlinNoise2D moisture_noise(random, WorldNoiseScale);
+
+      // first pass: raw noise values and their range on each tile
+
+      const std::size_t tile_count = static_cast<std::size_t>(TerrainTileCount.w) * static_cast<std::size_t>(TerrainTileCount.h);
+      std::vector<TerrainRange> ranges(tile_count);
+
+      pool.parallel_for(tile_count, [&](std::size_t index) {
+        TerrainRange& range = ranges[index];
+
+        for (const gf::Vec2I position : gf::rectangle_range(compute_terrain_tile(index))) {
+          const double altitude = compute_noise_value(&altitude_noise, position);
+          const double moisture = compute_noise_value(&moisture_noise, position);
+          raw.altitude(position) = static_cast<float>(altitude);
+          raw.moisture(position) = static_cast<float>(moisture);
 
-      if (moisture < MoistureHiThreshold) {
-        return value * 5;
+          range.altitude_min = std::min(range.altitude_min, altitude);
+          range.altitude_max = std::max(range.altitude_max, altitude);
+          range.moisture_min = std::min(range.moisture_min, moisture);
+          range.moisture_max = std::max(range.moisture_max, moisture);
+        }
+      });
+
+      TerrainRange range;
+
+      for (const TerrainRange& tile_range : ranges) {
+        range.merge(tile_range);
       }
 
-      return value;
+      // second pass: normalization in [0, 1] and padding
+
+      const double altitude_factor = 1.0 / (range.altitude_max - range.altitude_min);
+      const double moisture_factor = 1.0 / (range.moisture_max - range.moisture_min);
+
+      pool.parallel_for(tile_count, [&](std::size_t index) {
+        for (const gf::Vec2I position : gf::rectangle_range(compute_terrain_tile(index))) {
+          const double altitude = 0.0 + (raw.altitude(position) - range.altitude_min) * altitude_factor;
+          const double moisture = 0.0 + (raw.moisture(position) - range.moisture_min) * moisture_factor;
+
+          const double factor = compute_padding_factor(position);
+          raw.altitude(position) = static_cast<float>(1.0 - (1.0 - altitude) * gf::ease_out_cubic(factor));
+          raw.moisture(position) = static_cast<float>(moisture);
+        }
+      });
+
+      return raw;
     }
 
     struct River {
       std::vector<gf::Vec2I> path;
     };
 
-    std::vector<River> generate_rivers(const RawWorld& raw, gf::Random* random)
+    std::vector<River> generate_rivers(const RawWorld& raw, gf::Random* random, WorkerPool& pool, WorldGenerationStatistics& statistics)
     {
       std::vector<River> rivers;
 
@@ -283,7 +369,7 @@ namespace fw {
 
         for (;;) {
           const gf::Vec2I source = random->compute_position(area);
-          const double moisture = raw(source).moisture;
+          const float moisture = raw.moisture(source);
 
           if (moisture > RiverSourceMinMoisture) {
             return source;
@@ -342,23 +428,25 @@ namespace fw {
       }
 
       gf::Log::debug("\tFound river points after {} rounds", round);
+      statistics.river_rounds = static_cast<int>(round);
 
       // compute the rivers
 
-      gf::GridMap grid = gf::GridMap::make_orthogonal(WorldSize);
+      RiverCosts costs;
+      costs.slope_factor = RiverSlopeFactor;
+      costs.min_moisture = static_cast<float>(RiverMinMoisture);
+      costs.low_moisture = static_cast<float>(MoistureLoThreshold);
+      costs.low_moisture_factor = 10;
+      costs.high_moisture = static_cast<float>(MoistureHiThreshold);
+      costs.high_moisture_factor = 5;
 
-      for (const gf::Vec2I position : raw.position_range()) {
-        if (raw(position).moisture < RiverMinMoisture) {
-          grid.set_walkable(position, false);
-        }
-      }
+      RiverRouter router(raw.altitude, raw.moisture, costs, pool);
 
       for (const gf::Vec2I source : { points[1], points[2] }) {
-        std::vector<gf::Vec2I> river = grid.compute_route(source, points[0], [&](gf::Vec2I position, gf::Vec2I neighbor) {
-          return distance_for_rivers(raw, position, neighbor);
-        });
+        std::vector<gf::Vec2I> river = router.compute_route(source, points[0]);
 
         gf::Log::debug("\triver: length = {}", river.size());
+        statistics.river_length += river.size();
 
         rivers.emplace_back(std::move(river));
       }
@@ -366,9 +454,16 @@ namespace fw {
       return rivers;
     }
 
-    RawWorld modify_raw_with_rivers(const RawWorld& raw, const std::vector<River>& rivers, gf::Random* random)
+    void modify_raw_with_rivers(RawWorld& raw, const std::vector<River>& rivers, gf::Random* random)
     {
-      RawWorld new_raw(raw);
+      // the moisture is modified in place, the values before the rivers are
+      // kept only for the cells inside the river corridors
+
+      std::unordered_map<std::size_t, float> original_moisture;
+
+      auto save_original_moisture = [&](gf::Vec2I position) {
+        return original_moisture.try_emplace(raw.index(position), raw.moisture(position)).first->second;
+      };
 
       for (const River& river : rivers) {
         const int radius = random->compute_uniform_integer(RiverRadiusMin, RiverRadiusMax);
@@ -377,8 +472,9 @@ namespace fw {
         for (const gf::Vec2I position : river.path) {
           // elevate humidity around the river
 
-          new_raw(position).moisture = 1.0; // std::max(new_raw(position).moisture, std::min(raw(position).moisture * 1.5, 1.0));
-          const double height = new_raw(position).moisture;
+          save_original_moisture(position);
+          raw.moisture(position) = 1.0f; // std::max(raw.moisture(position), std::min(original * 1.5, 1.0));
+          const double height = raw.moisture(position);
           const double factor = height / radius_square;
 
 
@@ -390,14 +486,15 @@ namespace fw {
             const int distance_square = gf::square_distance(position, neighbor);
 
             if (distance_square < radius_square) {
-              double moisture_offset = factor * (radius_square - distance_square);
-              new_raw(neighbor).moisture = std::max(new_raw(neighbor).moisture, raw(neighbor).moisture + moisture_offset);
+              const double moisture_offset = factor * (radius_square - distance_square);
+              const float original = save_original_moisture(neighbor);
+              raw.moisture(neighbor) = std::max(raw.moisture(neighbor), static_cast<float>(original + moisture_offset));
             }
           }
         }
       }
 
-      return new_raw;
+      gf::Log::debug("\triver corridors: {} cells", original_moisture.size());
     }
 
 
@@ -408,56 +505,68 @@ namespace fw {
      * values. The constraint is that there must be no desert next to a forest.
      *
      * In this step, simple blocks and decorations are added: trees, cactuses,
-     * herbs.
+     * herbs. They are part of the state and not of the chunks bound around
+     * the hero: the trees and the cactuses block the actors everywhere on the
+     * map, the railways clear them and the animals are placed between them.
      */
 
-    MapState generate_outline(const RawWorld& raw, gf::Random* random, const std::vector<River>& rivers)
+    MapState generate_outline(const RawWorld& raw, const RandomStreams& streams, const std::vector<River>& rivers, WorkerPool& pool, DebugImageSink& debug_images)
     {
       MapState state = {};
       state.ground = { WorldSize };
 
-      for (const gf::Vec2I position : state.ground.position_range()) {
-        MapCell& cell = state.ground(position);
-        const RawCell& raw_cell = raw(position);
-
-        /*
-         *          1 +---------+--------+
-         *            | Moutain | Forest |
-         *            +--------++--------+
-         *            | Desert | Prairie |
-         * altitude 0 +--------+---------+
-         *            0                  1
-         *            moisture
-         */
-
-        if (raw_cell.altitude < AltitudeThreshold) {
-          if (raw_cell.moisture < MoistureLoThreshold) {
-            cell.region = MapCellBiome::Desert;
-
-            if (random->compute_bernoulli(DesertCactusProbability * raw_cell.moisture / MoistureLoThreshold)) {
-              cell.decoration = MapCellDecoration::Cactus;
-            }
-          } else {
-            cell.region = MapCellBiome::Prairie;
+      // the decorations are drawn from the position, so the rows are independent
 
-            if (random->compute_bernoulli(PrairieHerbProbability * raw_cell.moisture)) {
-              cell.decoration = MapCellDecoration::Herb;
-            }
-          }
-        } else {
-          if (raw_cell.moisture < MoistureHiThreshold) {
-            cell.region = MapCellBiome::Mountain;
+      auto compute_bernoulli = [&](gf::Vec2I position, double probability) {
+        return streams.compute_bernoulli(WorldGenerationStep::Biomes, position, probability);
+      };
+
+      pool.parallel_for(static_cast<std::size_t>(WorldSize.h), [&](std::size_t y) {
+        for (int32_t x = 0; x < WorldSize.w; ++x) {
+          const gf::Vec2I position = { x, static_cast<int32_t>(y) };
+          MapCell& cell = state.ground(position);
+          const float altitude = raw.altitude(position);
+          const float moisture = raw.moisture(position);
+
+          /*
+           *          1 +---------+--------+
+           *            | Moutain | Forest |
+           *            +--------++--------+
+           *            | Desert | Prairie |
+           * altitude 0 +--------+---------+
+           *            0                  1
+           *            moisture
+           */
+
+          if (altitude < AltitudeThreshold) {
+            if (moisture < MoistureLoThreshold) {
+              cell.region = MapCellBiome::Desert;
+
+              if (compute_bernoulli(position, DesertCactusProbability * moisture / MoistureLoThreshold)) {
+                cell.decoration = MapCellDecoration::Cactus;
+              }
+            } else {
+              cell.region = MapCellBiome::Prairie;
 
-            // cliffs are put later
+              if (compute_bernoulli(position, PrairieHerbProbability * moisture)) {
+                cell.decoration = MapCellDecoration::Herb;
+              }
+            }
           } else {
-            cell.region = MapCellBiome::Forest;
+            if (moisture < MoistureHiThreshold) {
+              cell.region = MapCellBiome::Mountain;
+
+              // cliffs are put later
+            } else {
+              cell.region = MapCellBiome::Forest;
 
-            if (is_on_side(position) || random->compute_bernoulli(ForestTreeProbability * raw_cell.moisture)) {
-              cell.decoration = MapCellDecoration::Tree;
+              if (is_on_side(position) || compute_bernoulli(position, ForestTreeProbability * moisture)) {
+                cell.decoration = MapCellDecoration::Tree;
+              }
             }
           }
         }
-      }
+      });
 
       for (const River& river : rivers) {
         for (const auto [ index, position ] : gf::enumerate(river.path)) {
@@ -476,10 +585,9 @@ namespace fw {
         }
       }
 
-      if constexpr (Debug) {
-        gf::Image image = compute_basic_image(state.ground);
-        image.save_to_file("00_outline.png");
-      }
+      debug_images.submit("00_outline.png", [&]() {
+        return compute_basic_image(state.ground);
+      });
 
       return state;
     }
@@ -491,127 +599,66 @@ namespace fw {
      * all the blocks are in place.
      */
 
-    void generate_mountains(MapState& state, gf::Random* random)
+    void generate_mountains(MapState& state, const RandomStreams& streams, WorkerPool& pool, DebugImageSink& debug_images)
     {
-      enum Type : uint8_t {
-        Ground,
-        Cliff,
-      };
-
-      gf::Array2D<Type> map(WorldSize, Ground);
-
-      for (const gf::Vec2I position : state.ground.position_range()) {
-        if (state.ground(position).region == MapCellBiome::Mountain) {
-          if (random->compute_bernoulli(MoutainThreshold)) {
-            map(position) = Cliff;
-          }
-        }
-      }
-
-      gf::Array2D<Type> next(WorldSize);
-
-      /*
-       * +-+-+-+-+-+
-       * | | |X| | |
-       * +-+-+-+-+-+
-       * | |X|X|X| |
-       * +-+-+-+-+-+
-       * |X|X|P|X|X|
-       * +-+-+-+-+-+
-       * | |X|X|X| |
-       * +-+-+-+-+-+
-       * | | |X| | |
-       * +-+-+-+-+-+
-       */
-
-
-      static constexpr gf::Vec2I TwelveNeighbors[] = {
-        // clang-format off
-                                {  0, -2 },
-                    { -1, -1 }, {  0, -1 }, { +1, -1 },
-        { -2,  0 }, { -1,  0 },             { +1,  0 }, { +2, 0 },
-                    { -1, +1 }, {  0, +1 }, { +1, +1 },
-                                {  0, +2 },
-        // clang-format on
-      };
-
-      for (int i = 0; i < MoutainIterations; ++i) {
-        for (const gf::Vec2I position : map.position_range()) {
-          if (state.ground(position).region != MapCellBiome::Mountain) {
-            continue;
-          }
+      // one bit per cell: set for ground, unset for cliff, only mountains evolve
 
-          int count = 0;
+      BitGrid mountains(WorldSize);
+      BitGrid map(WorldSize, true);
 
-          for (const gf::Vec2I relative_neighbor : TwelveNeighbors) {
-            const gf::Vec2I neighbor = position + relative_neighbor;
+      pool.parallel_for(static_cast<std::size_t>(WorldSize.h), [&](std::size_t y) {
+        for (int32_t x = 0; x < WorldSize.w; ++x) {
+          const gf::Vec2I position = { x, static_cast<int32_t>(y) };
 
-            if (map.valid(neighbor)) {
-              count += map(neighbor) == Ground ? 1 : 0;
-            }
-          }
+          if (state.ground(position).region == MapCellBiome::Mountain) {
+            mountains.set(position);
 
-          if (map(position) == Ground) {
-            if (count >= MoutainSurvivalThreshold) {
-              next(position) = Ground;
-            } else {
-              next(position) = Cliff;
-            }
-          } else {
-            if (count >= MoutainBirthThreshold) {
-              next(position) = Ground;
-            } else {
-              next(position) = Cliff;
+            if (streams.compute_bernoulli(WorldGenerationStep::Moutains, position, MoutainThreshold)) {
+              map.set(position, false);
             }
           }
         }
+      });
 
+      const std::vector<BitSpan> spans = compute_row_spans(mountains);
+      BitGrid next(WorldSize);
+
+      for (int i = 0; i < MoutainIterations; ++i) {
+        step_twelve_neighbors(map, next, mountains, spans, { MoutainSurvivalThreshold, MoutainBirthThreshold }, pool);
         std::swap(map, next);
       }
 
       // check for isolated Ground
 
-      constexpr gf::Vec2I FourNeighbors[] = {
-        { 0, -1 }, { -1, 0 }, { +1, 0 }, { 0, +1 }
-      };
-
-      for (const gf::Vec2I position : map.position_range()) {
-        if (state.ground(position).region != MapCellBiome::Mountain) {
-          continue;
-        }
+      clear_isolated(map, mountains, spans, pool);
 
-        if (map(position) == Ground) {
-          bool isolated = true;
+      // put in outline
 
-          for (const gf::Vec2I relative_neighbor : FourNeighbors) {
-            const gf::Vec2I neighbor = position + relative_neighbor;
+      for (int32_t y = 0; y < WorldSize.h; ++y) {
+        const BitSpan span = spans[y];
 
-            if (map.valid(neighbor) && map(neighbor) == Ground) {
-              isolated = false;
-              break;
-            }
-          }
+        for (int32_t x = span.first; x <= span.last; ++x) {
+          BitGrid::Word cliffs = mountains.word(x, y) & ~map.word(x, y);
 
-          if (isolated) {
-            map(position) = Cliff;
+          while (cliffs != 0) {
+            const gf::Vec2I position = { x * BitGrid::WordBits + std::countr_zero(cliffs), y };
+            state.ground(position).decoration = MapCellDecoration::Cliff;
+            cliffs &= cliffs - 1;
           }
         }
       }
 
-      // put in outline
-
-      for (const gf::Vec2I position : map.position_range()) {
-        if (map(position) == Cliff) {
-          state.ground(position).decoration = MapCellDecoration::Cliff;
-        } else if (state.ground(position).region == MapCellBiome::Mountain && is_on_side(position)) {
-          state.ground(position).decoration = MapCellDecoration::Cliff;
+      for (int32_t i = 0; i < WorldBasicSize; ++i) {
+        for (const gf::Vec2I position : { gf::Vec2I(i, 0), gf::Vec2I(i, WorldBasicSize - 1), gf::Vec2I(0, i), gf::Vec2I(WorldBasicSize - 1, i) }) {
+          if (state.ground(position).region == MapCellBiome::Mountain) {
+            state.ground(position).decoration = MapCellDecoration::Cliff;
+          }
         }
       }
 
-      if constexpr (Debug) {
-        gf::Image image = compute_basic_image(state.ground, ImageType::Blocks);
-        image.save_to_file("01_blocks.png");
-      }
+      debug_images.submit("01_blocks.png", [&]() {
+        return compute_basic_image(state.ground, ImageType::Blocks);
+      });
 
     }
 
@@ -638,38 +685,6 @@ namespace fw {
       std::array<OuterTown, TownsCount> towns;
       std::array<OuterLocality, LocalityCount> localities;
 
-      int32_t min_distance_between_towns() const
-      {
-        gf::Span<const OuterTown> other_towns(towns.data(), towns.size());
-
-        int32_t min_distance = std::numeric_limits<int32_t>::max();
-
-        for (const OuterTown& town : towns) {
-          other_towns = other_towns.last_except<1>();
-          const int32_t distance = min_distance_to(town.center, other_towns);
-          min_distance = std::min(min_distance, distance);
-        }
-
-        return min_distance;
-      }
-
-      int32_t min_distance_between_towns_and_localities() const
-      {
-        gf::Span<const OuterTown> other_towns(towns.data(), towns.size());
-        gf::Span<const OuterLocality> other_localities(localities.data(), localities.size());
-
-        int32_t min_distance = std::numeric_limits<int32_t>::max();
-
-        for (const OuterLocality& locality : localities) {
-          other_localities = other_localities.last_except<1>();
-          const int32_t distance_to_localities = min_distance_to(locality.center, other_localities);
-          const int32_t distance_to_towns = min_distance_to(locality.center, other_towns);
-          min_distance = std::min({ min_distance, distance_to_localities, distance_to_towns });
-        }
-
-        return min_distance;
-      }
-
       template<typename T>
       int32_t min_distance_to(gf::Vec2I origin, gf::Span<const T> others) const
       {
@@ -726,64 +741,186 @@ namespace fw {
     }
 
 
-    bool can_have_place(const MapState& state, gf::Vec2I position, int32_t radius)
+    SummedAreaTable compute_open_prairie_table(const MapState& state)
+    {
+      return SummedAreaTable(WorldSize, [&](gf::Vec2I position) {
+        const MapCell& cell = state.ground(position);
+        return cell.region == MapCellBiome::Prairie && cell.decoration != MapCellDecoration::Water;
+      });
+    }
+
+    bool can_have_place(const SummedAreaTable& open_prairie, gf::Vec2I position, int32_t radius)
     {
-      assert(state.ground.valid(position));
+      assert(gf::RectI::from_size(WorldSize).contains(position));
 
-      if (state.ground(position).region != MapCellBiome::Prairie) {
+      const gf::RectI area = gf::RectI::from_position_size(position - radius, { 2 * radius + 1, 2 * radius + 1 });
+
+      if (area.position().x < 0 || area.position().y < 0 || area.position().x + area.size().w > WorldSize.w || area.position().y + area.size().h > WorldSize.h) {
         return false;
       }
 
-      for (const gf::Vec2I neighbor : state.ground.square_range(position, radius)) {
-        if (!state.ground.valid(neighbor)) {
-          return false;
-        }
+      // all prairie, no water
+      return open_prairie.count(area) == static_cast<uint32_t>(area.size().w * area.size().h);
+    }
+
+    std::vector<gf::Vec2I> compute_place_candidates(const SummedAreaTable& open_prairie, int32_t radius, WorkerPool& pool)
+    {
+      constexpr gf::Vec2I ReducedSize = WorldSize / ReducedFactor;
+      std::vector<std::vector<gf::Vec2I>> rows(ReducedSize.h);
 
-        const MapCell& cell = state.ground(neighbor);
+      pool.parallel_for(rows.size(), [&](std::size_t y) {
+        for (int32_t x = 0; x < ReducedSize.w; ++x) {
+          const gf::Vec2I position(x, static_cast<int32_t>(y));
 
-        if (cell.region != MapCellBiome::Prairie) {
-          return false;
+          if (can_have_place(open_prairie, to_map(position), radius)) {
+            rows[y].push_back(position);
+          }
         }
+      });
 
-        if (cell.decoration == MapCellDecoration::Water) {
-          return false;
-        }
+      std::vector<gf::Vec2I> candidates;
+
+      for (const std::vector<gf::Vec2I>& row : rows) {
+        candidates.insert(candidates.end(), row.begin(), row.end());
       }
 
-      return true;
+      return candidates;
     }
 
-    WorldPlaces generate_places(const MapState& state, gf::Random* random)
+    /*
+     * Dart throwing among the candidates. A candidate is accepted if its
+     * (manhattan) distance to the fixed places and to the places already
+     * accepted is greater than the minimum distance. The accepted places are
+     * put in a grid of cells of the minimum distance, so that only the nine
+     * cells around a candidate are checked.
+     *
+     * A round has a bounded number of attempts. After a bounded number of
+     * rounds, the minimum distance is reduced. When the rounds at distance 0
+     * fail too, the sampling stops with the best round, that has fewer places
+     * than requested.
+     */
+
+    struct PlaceSampling {
+      std::vector<gf::Vec2I> places;
+      int rounds = 0;
+      int32_t min_distance = 0;
+    };
+
+    PlaceSampling sample_places(const std::vector<gf::Vec2I>& candidates, std::size_t count, int32_t min_distance, const std::vector<gf::Vec2I>& fixed, gf::Random* random)
     {
-      constexpr gf::RectI reduced_world_rectangle = gf::RectI::from_size(WorldSize / ReducedFactor);
+      constexpr gf::Vec2I ReducedSize = WorldSize / ReducedFactor;
 
-      WorldPlaces places = {};
+      PlaceSampling sampling;
+      sampling.min_distance = min_distance;
 
-      // first generate towns
+      if (candidates.empty()) {
+        gf::Log::warning("No candidate for {} places", count);
+        return sampling;
+      }
 
-      int town_rounds = 0;
+      std::vector<gf::Vec2I> best_places;
 
       for (;;) {
-        [[maybe_unused]] int tries = 0;
+        const int32_t cell_size = std::max(sampling.min_distance, 1);
+        gf::Array2D<std::vector<gf::Vec2I>> grid(ReducedSize / cell_size + 1);
+
+        auto is_far_enough = [&](gf::Vec2I position) {
+          const gf::Vec2I cell = position / cell_size;
+
+          for (const gf::Vec2I relative_neighbor : NineArea) {
+            const gf::Vec2I neighbor_cell = cell + relative_neighbor;
+
+            if (!grid.valid(neighbor_cell)) {
+              continue;
+            }
 
-        for (OuterTown& town : places.towns) {
-          do {
-            town.center = random->compute_position(reduced_world_rectangle);
-            ++tries;
-          } while (!can_have_place(state, to_map(town.center), TownRadius + RailSpacing * ReducedFactor));
+            for (const gf::Vec2I other : grid(neighbor_cell)) {
+              if (gf::manhattan_distance(position, other) <= sampling.min_distance) {
+                return false;
+              }
+            }
+          }
+
+          return true;
+        };
+
+        for (int round = 0; round < PlaceMaxRounds; ++round) {
+          ++sampling.rounds;
+
+          for (std::vector<gf::Vec2I>& cell : grid) {
+            cell.clear();
+          }
+
+          for (const gf::Vec2I position : fixed) {
+            grid(position / cell_size).push_back(position);
+          }
+
+          sampling.places.clear();
+
+          for (std::size_t attempt = 0; attempt < PlaceAttemptsPerPlace * count && sampling.places.size() < count; ++attempt) {
+            const gf::Vec2I position = candidates[random->compute_uniform_integer(candidates.size())];
+
+            if (is_far_enough(position)) {
+              grid(position / cell_size).push_back(position);
+              sampling.places.push_back(position);
+            }
+          }
+
+          if (sampling.places.size() == count) {
+            return sampling;
+          }
+
+          if (sampling.places.size() > best_places.size()) {
+            best_places = sampling.places;
+          }
         }
 
-        const int32_t min_distance = places.min_distance_between_towns();
-        // gf::Log::info("Found potential towns after {} tries with min distance {}", tries, min_distance);
+        if (sampling.min_distance == 0) {
+          gf::Log::warning("Could only place {} places out of {} after {} rounds", best_places.size(), count, sampling.rounds);
+          sampling.places = std::move(best_places);
+          return sampling;
+        }
 
-        ++town_rounds;
+        const int32_t relaxed_distance = sampling.min_distance * PlaceDistanceRelaxation / 100;
+        gf::Log::warning("Could not place {} places at distance {} after {} rounds, trying distance {}", count, sampling.min_distance, sampling.rounds, relaxed_distance);
+        sampling.min_distance = relaxed_distance;
+      }
+    }
 
-        if (min_distance * ReducedFactor > TownMinDistanceFromOther) {
-          break;
+    // the sampling is drawn again if it fails, and the generation stops if it still fails
+    PlaceSampling sample_all_places(const std::vector<gf::Vec2I>& candidates, std::size_t count, int32_t min_distance, const std::vector<gf::Vec2I>& fixed, gf::Random* random)
+    {
+      int rounds = 0;
+
+      for (int i = 0; i < PlaceMaxSamplings; ++i) {
+        PlaceSampling sampling = sample_places(candidates, count, min_distance, fixed, random);
+        rounds += sampling.rounds;
+
+        if (sampling.places.size() == count) {
+          sampling.rounds = rounds;
+          return sampling;
         }
       }
 
-      gf::Log::info("Towns generated after {} rounds", town_rounds);
+      gf::Log::fatal("Could not place {} places among {} candidates", count, candidates.size());
+      return {};
+    }
+
+    WorldPlaces generate_places(const MapState& state, const SummedAreaTable& open_prairie, gf::Random* random, WorkerPool& pool, DebugImageSink& debug_images, WorldGenerationStatistics& statistics)
+    {
+      WorldPlaces places = {};
+
+      // first generate towns
+
+      const std::vector<gf::Vec2I> town_candidates = compute_place_candidates(open_prairie, TownRadius + RailSpacing * ReducedFactor, pool);
+      const PlaceSampling town_sampling = sample_all_places(town_candidates, TownsCount, TownMinDistanceFromOther / ReducedFactor, {}, random);
+
+      for (std::size_t i = 0; i < TownsCount; ++i) {
+        places.towns[i].center = town_sampling.places[i];
+      }
+
+      gf::Log::info("Towns generated after {} rounds ({} candidates)", town_sampling.rounds, town_candidates.size());
+      statistics.town_rounds = town_sampling.rounds;
 
       // compute rail arrival/departure
 
@@ -840,26 +977,17 @@ namespace fw {
 
       // second generate localities
 
-      int locality_rounds = 0;
-
-      for (;;) {
-        [[maybe_unused]] int tries = 0;
-
-        for (OuterLocality& locality : places.localities) {
-          do {
-            locality.center = random->compute_position(reduced_world_rectangle);
-            ++tries;
-          } while (!can_have_place(state, to_map(locality.center), LocalityRadius));
-        }
+      std::vector<gf::Vec2I> town_centers;
 
-        const int32_t min_distance = places.min_distance_between_towns_and_localities();
-        // gf::Log::info("Found potential locality after {} tries with min distance {}", tries, min_distance);
+      for (const OuterTown& town : places.towns) {
+        town_centers.push_back(town.center);
+      }
 
-        ++locality_rounds;
+      const std::vector<gf::Vec2I> locality_candidates = compute_place_candidates(open_prairie, LocalityRadius, pool);
+      const PlaceSampling locality_sampling = sample_all_places(locality_candidates, LocalityCount, LocalityMinDistanceFromOther / ReducedFactor, town_centers, random);
 
-        if (min_distance * ReducedFactor > LocalityMinDistanceFromOther) {
-          break;
-        }
+      for (std::size_t i = 0; i < LocalityCount; ++i) {
+        places.localities[i].center = locality_sampling.places[i];
       }
 
       // determine villages
@@ -889,13 +1017,13 @@ namespace fw {
         iterator->type = LocalityType::Camp;
       }
 
-      gf::Log::info("Localities generated after {} rounds", locality_rounds);
+      gf::Log::info("Localities generated after {} rounds ({} candidates)", locality_sampling.rounds, locality_candidates.size());
+      statistics.locality_rounds = locality_sampling.rounds;
 
-      if constexpr (Debug) {
-        gf::Image image = compute_basic_image(state.ground, ImageType::Blocks);
-        image = compute_image_add_towns_and_localities(image, places);
-        image.save_to_file("02_places.png");
-      }
+      debug_images.submit("02_places.png", [&]() {
+        const gf::Image image = compute_basic_image(state.ground, ImageType::Blocks);
+        return compute_image_add_towns_and_localities(image, places);
+      });
 
       return places;
     }
@@ -912,27 +1040,29 @@ namespace fw {
         image.put_pixel(position, gf::Black);
       }
 
-      for (const gf::Vec2I position : network.roads) {
+      for (const gf::Vec2I position : network.compute_road_points()) {
         image.put_pixel(position, gf::Gray);
       }
 
       return image;
     }
 
-    gf::GridMap compute_basic_grid(const MapState& state)
+    SummedAreaTable compute_cliff_table(const MapState& state)
+    {
+      return SummedAreaTable(WorldSize, [&](gf::Vec2I position) {
+        return state.ground(position).decoration == MapCellDecoration::Cliff;
+      });
+    }
+
+    gf::GridMap compute_basic_grid(const SummedAreaTable& cliff_table)
     {
       gf::GridMap grid = gf::GridMap::make_orthogonal(WorldSize / ReducedFactor);
 
       for (const gf::Vec2I position : grid.position_range()) {
         const gf::Vec2I map_position = to_map(position);
 
-        int cliffs = 0;
-
-        for (const gf::Vec2I neighbor : state.ground.compute_24_neighbors_range(map_position)) {
-          if (state.ground(neighbor).decoration == MapCellDecoration::Cliff) {
-            ++cliffs;
-          }
-        }
+        // the 24 neighbors: the 5x5 square without the center
+        const uint32_t cliffs = cliff_table.count(gf::RectI::from_position_size(map_position - 2, { 5, 5 })) - cliff_table.count(gf::RectI::from_position_size(map_position, { 1, 1 }));
 
         grid.set_walkable(position, cliffs <= CliffThreshold);
       }
@@ -943,29 +1073,15 @@ namespace fw {
     float distance_with_slope_reduced(const RawWorld& raw, gf::Vec2I position, gf::Vec2I neighbor)
     {
       const float distance = gf::euclidean_distance<float>(position, neighbor);
-      const float slope = static_cast<float>(std::abs(raw(to_map(position)).altitude - raw(to_map(neighbor)).altitude)) / distance;
+      const float slope = std::abs(raw.altitude(to_map(position)) - raw.altitude(to_map(neighbor))) / distance;
       return distance * (1 + SlopeFactor * gf::square(slope));
     }
 
-    bool has_water_nearby(const MapState& state, gf::Vec2I position) {
-      if (state.ground(position).decoration == MapCellDecoration::Water) {
-        return true;
-      }
-
-      for (const gf::Vec2I neighbor : state.ground.compute_8_neighbors_range(position)) {
-        if (state.ground(neighbor).decoration == MapCellDecoration::Water) {
-          return true;
-        }
-      }
-
-      return false;
-    }
-
-    NetworkState generate_network(const RawWorld& raw, MapState& state, const WorldPlaces& places, gf::Random* random)
+    NetworkState generate_network(const RawWorld& raw, MapState& state, const SummedAreaTable& cliff_table, const WaterMask& water, const WorldPlaces& places, gf::Random* random, WorkerPool& pool, DebugImageSink& debug_images)
     {
       // initialize the grid
 
-      gf::GridMap grid = compute_basic_grid(state);
+      gf::GridMap grid = compute_basic_grid(cliff_table);
 
       for (const OuterTown& town : places.towns) {
         const gf::RectI town_space = gf::RectI::from_center_size(town.center, { ReducedTownDiameter, ReducedTownDiameter });
@@ -989,7 +1105,7 @@ namespace fw {
         }
       }
 
-      if constexpr (Debug) {
+      debug_images.submit("03_railways_alt.png", [&]() {
         gf::Image image(grid.size());
 
         for (const gf::Vec2I position : image.position_range()) {
@@ -1000,8 +1116,18 @@ namespace fw {
           }
         }
 
-        image.save_to_file("03_railways_alt.png");
-      }
+        return image;
+      });
+
+      HierarchicalPathfinder pathfinder(grid, [&](gf::Vec2I position, gf::Vec2I neighbor) {
+        const float distance = distance_with_slope_reduced(raw, position, neighbor);
+
+        if (water.has_water(neighbor)) {
+          return distance * RiverPenalty;
+        }
+
+        return distance;
+      }, pool);
 
       std::vector<std::vector<gf::Vec2I>> paths;
 
@@ -1020,19 +1146,11 @@ namespace fw {
         // path to the next town
 
         const std::size_t j = (i + 1) % places.towns.size();
-        auto path = grid.compute_route(places.towns[i].rail_departure, places.towns[j].rail_arrival, [&](gf::Vec2I position, gf::Vec2I neighbor) {
-          const float distance = distance_with_slope_reduced(raw, position, neighbor);
-
-          if (has_water_nearby(state, to_map(neighbor))) {
-            return distance * RiverPenalty;
-          }
-
-          return distance;
-        });
+        auto path = pathfinder.compute_route(places.towns[i].rail_departure, places.towns[j].rail_arrival);
 
         for (const gf::Vec2I point : path) {
           for (const gf::Vec2I relative_neighbor : NineArea) {
-            grid.set_walkable(point + relative_neighbor, false);
+            pathfinder.set_walkable(point + relative_neighbor, false);
           }
         }
 
@@ -1107,27 +1225,165 @@ namespace fw {
         }
       }
 
-      if constexpr (Debug) {
+      debug_images.submit("03_railways.png", [&]() {
         gf::Image image = compute_basic_image(state.ground, ImageType::Blocks);
         image = compute_image_add_towns_and_localities(image, places);
-        image = compute_image_add_network(image, network);
-        image.save_to_file("03_railways.png");
-      }
+        return compute_image_add_network(image, network);
+      });
 
       gf::Log::info("Railway length: {}", network.railway.size() * ReducedFactor);
 
       return network;
     }
 
+    bool is_in_place(gf::Vec2I position, const WorldPlaces& places)
+    {
+      for (const OuterTown& town : places.towns) {
+        const gf::RectI town_space = gf::RectI::from_center_size(town.center, { ReducedTownDiameter, ReducedTownDiameter });
+
+        if (town_space.contains(position)) {
+          return true;
+        }
+      }
+
+      for (const OuterLocality& locality : places.localities) {
+        const gf::RectI locality_space = gf::RectI::from_center_size(locality.center, { ReducedLocalityDiameter, ReducedLocalityDiameter });
+
+        if (locality_space.contains(position)) {
+          return true;
+        }
+      }
+
+      return false;
+    }
+
+    bool is_place_center(gf::Vec2I position, const WorldPlaces& places)
+    {
+      for (const OuterTown& town : places.towns) {
+        if (town.center == position) {
+          return true;
+        }
+      }
+
+      for (const OuterLocality& locality : places.localities) {
+        if (locality.center == position) {
+          return true;
+        }
+      }
+
+      return false;
+    }
+
+    /*
+     * The road graph is the union of the paths. The nodes are the centers of
+     * the places and the cells where the roads do not just go on (crossroads
+     * and dead ends). The sections are the roads between the nodes.
+     */
+
+    void compute_road_graph(const std::vector<std::vector<gf::Vec2I>>& paths, const WorldPlaces& places, NetworkState& network)
+    {
+      // bit i is set if the cell is linked to its neighbor in direction i
+
+      static constexpr gf::Vec2I LinkDirections[] = {
+        { 0, -1 }, { +1, 0 }, { 0, +1 }, { -1, 0 }
+      };
+
+      auto link_index = [](gf::Vec2I displacement) {
+        for (std::size_t i = 0; i < std::size(LinkDirections); ++i) {
+          if (LinkDirections[i] == displacement) {
+            return i;
+          }
+        }
+
+        assert(false);
+        return std::size_t(0);
+      };
+
+      auto opposite_link = [](std::size_t index) {
+        return (index + 2) % std::size(LinkDirections);
+      };
+
+      gf::Array2D<uint8_t> links(WorldSize / ReducedFactor, 0);
+
+      for (const std::vector<gf::Vec2I>& path : paths) {
+        for (std::size_t i = 1; i < path.size(); ++i) {
+          const std::size_t index = link_index(path[i] - path[i - 1]);
+          links(path[i - 1]) |= uint8_t(1 << index);
+          links(path[i]) |= uint8_t(1 << opposite_link(index));
+        }
+      }
+
+      // nodes
+
+      constexpr uint32_t NoNode = std::numeric_limits<uint32_t>::max();
+      gf::Array2D<uint32_t> nodes(links.size(), NoNode);
+      std::vector<gf::Vec2I> node_positions;
+
+      for (const gf::Vec2I position : links.position_range()) {
+        const uint8_t cell_links = links(position);
+
+        if (cell_links == 0) {
+          continue;
+        }
+
+        const bool center = is_place_center(position, places);
+
+        if (center || std::popcount(cell_links) != 2) {
+          nodes(position) = static_cast<uint32_t>(network.road_nodes.size());
+          node_positions.push_back(position);
+          network.road_nodes.push_back({ to_map(position), center || is_in_place(position, places) ? RoadNodeType::Place : RoadNodeType::Crossroad });
+        }
+      }
+
+      // sections, each link is followed once
+
+      for (const gf::Vec2I node_position : node_positions) {
+        for (std::size_t i = 0; i < std::size(LinkDirections); ++i) {
+          if ((links(node_position) & (1 << i)) == 0) {
+            continue;
+          }
+
+          RoadSection section = {};
+          section.origin = nodes(node_position);
+
+          gf::Vec2I position = node_position;
+          std::size_t index = i;
+
+          for (;;) {
+            const gf::Vec2I next = position + LinkDirections[index];
+            links(position) &= uint8_t(~(1 << index));
+            links(next) &= uint8_t(~(1 << opposite_link(index)));
+            position = next;
+
+            if (nodes(position) != NoNode) {
+              break;
+            }
+
+            if (!is_in_place(position, places)) {
+              section.points.push_back(to_map(position));
+            }
+
+            assert(std::popcount(links(position)) == 1);
+            index = static_cast<std::size_t>(std::countr_zero(links(position)));
+          }
+
+          section.target = nodes(position);
+          network.road_sections.push_back(std::move(section));
+        }
+      }
+
+      gf::Log::info("Roads: {} nodes, {} sections", network.road_nodes.size(), network.road_sections.size());
+    }
+
     /*
      * Step ?. Generate roads
      *
      *
      */
 
-    void generate_roads(const RawWorld& raw, const MapState& state, NetworkState& network, const WorldPlaces& places)
+    void generate_roads(const RawWorld& raw, const MapState& state, const SummedAreaTable& cliff_table, const WaterMask& water, NetworkState& network, const WorldPlaces& places, WorkerPool& pool, DebugImageSink& debug_images)
     {
-      gf::GridMap grid = compute_basic_grid(state);
+      gf::GridMap grid = compute_basic_grid(cliff_table);
 
       for (const OuterTown& town : places.towns) {
         const gf::RectI town_space = gf::RectI::from_center_size(town.center, { ReducedTownDiameter, ReducedTownDiameter });
@@ -1150,12 +1406,10 @@ namespace fw {
         grid.set_blocked(position);
       }
 
-      std::vector<gf::Vec2I> roads;
-
       const auto distance_function = [&](gf::Vec2I position, gf::Vec2I neighbor) {
         const float distance = distance_with_slope_reduced(raw, position, neighbor);
 
-        if (has_water_nearby(state, to_map(neighbor))) {
+        if (water.has_water(neighbor)) {
           return RiverPenalty * distance;
         }
 
@@ -1170,11 +1424,27 @@ namespace fw {
         return distance;
       };
 
+      HierarchicalPathfinder pathfinder(grid, distance_function, pool);
+
       const auto position_comparator = [](gf::Vec2I lhs, gf::Vec2I rhs) {
         return std::tie(lhs.x, lhs.y) < std::tie(rhs.x, rhs.y);
       };
 
+      // one search for all the destinations of a source
+
+      std::vector<std::vector<gf::Vec2I>> paths;
+
+      auto add_paths = [&](gf::Vec2I origin, const std::vector<gf::Vec2I>& targets) {
+        for (std::vector<gf::Vec2I>& path : pathfinder.compute_routes(origin, targets)) {
+          if (!path.empty()) {
+            paths.push_back(std::move(path));
+          }
+        }
+      };
+
       for (const OuterLocality& from : places.localities) {
+        std::vector<gf::Vec2I> targets;
+
         for (const OuterLocality& to : places.localities) {
           if (from.center == to.center) {
             continue;
@@ -1188,12 +1458,15 @@ namespace fw {
             continue;
           }
 
-          const std::vector<gf::Vec2I> road = grid.compute_route(from.center, to.center, distance_function);
-          roads.insert(roads.end(), road.begin(), road.end());
+          targets.push_back(to.center);
         }
+
+        add_paths(from.center, targets);
       }
 
       for (const OuterTown& from : places.towns) {
+        std::vector<gf::Vec2I> targets;
+
         for (const OuterLocality& to : places.localities) {
           if (from.center == to.center) {
             continue;
@@ -1203,45 +1476,19 @@ namespace fw {
             continue;
           }
 
-          const std::vector<gf::Vec2I> road = grid.compute_route(from.center, to.center, distance_function);
-          roads.insert(roads.end(), road.begin(), road.end());
-        }
-      }
-
-      std::sort(roads.begin(), roads.end(), position_comparator);
-
-      roads.erase(std::unique(roads.begin(), roads.end()), roads.end());
-
-      roads.erase(std::remove_if(roads.begin(), roads.end(), [&](const gf::Vec2I road) {
-        for (const OuterTown& town : places.towns) {
-          const gf::RectI town_space = gf::RectI::from_center_size(town.center, { ReducedTownDiameter, ReducedTownDiameter });
-
-          if (town_space.contains(road)) {
-            return true;
-          }
-        }
-
-        for (const OuterLocality& locality : places.localities) {
-          const gf::RectI locality_space = gf::RectI::from_center_size(locality.center, { ReducedLocalityDiameter, ReducedLocalityDiameter });
-
-          if (locality_space.contains(road)) {
-            return true;
-          }
+          targets.push_back(to.center);
         }
 
-        return false;
-      }), roads.end());
-
-      for (const gf::Vec2I position : roads) {
-        network.roads.push_back(to_map(position));
+        add_paths(from.center, targets);
       }
 
-      if constexpr (Debug) {
+      compute_road_graph(paths, places, network);
+
+      debug_images.submit("04_roads.png", [&]() {
         gf::Image image = compute_basic_image(state.ground, ImageType::Blocks);
         image = compute_image_add_towns_and_localities(image, places);
-        image = compute_image_add_network(image, network);
-        image.save_to_file("04_roads.png");
-      }
+        return compute_image_add_network(image, network);
+      });
     }
 
     /*
@@ -1487,9 +1734,74 @@ namespace fw {
      * in the following steps.
      */
 
+    struct RegionSpan {
+      gf::Vec2I start;
+      int32_t length;
+    };
+
+    /*
+     * A region is stored as horizontal spans in raster order. The prefix sums
+     * of the span lengths and a bucket index give any point of the region in
+     * (expected) constant time, for uniform sampling.
+     */
+
     struct WorldRegion {
-      std::vector<gf::Vec2I> points;
+      std::vector<RegionSpan> spans;
+      std::vector<uint32_t> offsets; // number of points before each span
+      std::vector<uint32_t> buckets; // first span of each bucket of points
+      uint32_t bucket_size = 1;
+      std::size_t point_count = 0;
       gf::RectI bounds;
+
+      std::size_t size() const
+      {
+        return point_count;
+      }
+
+      void add_span(RegionSpan span)
+      {
+        offsets.push_back(static_cast<uint32_t>(point_count));
+        spans.push_back(span);
+        point_count += static_cast<std::size_t>(span.length);
+      }
+
+      void compute_index()
+      {
+        bucket_size = static_cast<uint32_t>(std::max<std::size_t>(point_count / spans.size(), 1));
+        buckets.clear();
+
+        for (std::size_t i = 0; i < spans.size(); ++i) {
+          const std::size_t end = offsets[i] + static_cast<std::size_t>(spans[i].length);
+
+          while (buckets.size() * bucket_size < end) {
+            buckets.push_back(static_cast<uint32_t>(i));
+          }
+        }
+
+        gf::Vec2I min = spans.front().start;
+        gf::Vec2I max = spans.front().start;
+
+        for (const RegionSpan& span : spans) {
+          min.x = std::min(min.x, span.start.x);
+          min.y = std::min(min.y, span.start.y);
+          max.x = std::max(max.x, span.start.x + span.length - 1);
+          max.y = std::max(max.y, span.start.y);
+        }
+
+        bounds = gf::RectI::from_min_max(min, max + 1);
+      }
+
+      gf::Vec2I point(std::size_t index) const
+      {
+        assert(index < point_count);
+        std::size_t span = buckets[index / bucket_size];
+
+        while (span + 1 < spans.size() && offsets[span + 1] <= index) {
+          ++span;
+        }
+
+        return spans[span].start + gf::dirx(static_cast<int32_t>(index - offsets[span]));
+      }
     };
 
     struct WorldRegions {
@@ -1519,84 +1831,180 @@ namespace fw {
       }
     };
 
-    WorldRegions compute_regions(const MapState& state)
+    /*
+     * The regions are labelled with runs of cells of the same biome in each
+     * row. The runs of a band of rows are merged with a union-find on the
+     * worker pool, then the bands are merged along their seams.
+     */
+
+    constexpr int32_t RegionBandSize = 64;
+
+    struct RegionRun {
+      int32_t x;
+      int32_t length;
+      MapCellBiome biome;
+    };
+
+    class RunUnionFind {
+    public:
+      RunUnionFind(std::size_t count)
+      : m_parents(count)
+      {
+        for (std::size_t i = 0; i < count; ++i) {
+          m_parents[i] = static_cast<uint32_t>(i);
+        }
+      }
+
+      uint32_t find(uint32_t index)
+      {
+        while (m_parents[index] != index) {
+          m_parents[index] = m_parents[m_parents[index]];
+          index = m_parents[index];
+        }
+
+        return index;
+      }
+
+      void merge(uint32_t lhs, uint32_t rhs)
+      {
+        lhs = find(lhs);
+        rhs = find(rhs);
+
+        // the smallest index is the root, so that the roots are in raster order
+        if (lhs < rhs) {
+          m_parents[rhs] = lhs;
+        } else if (rhs < lhs) {
+          m_parents[lhs] = rhs;
+        }
+      }
+
+    private:
+      std::vector<uint32_t> m_parents;
+    };
+
+    WorldRegions compute_regions(const MapState& state, WorkerPool& pool)
     {
-      enum class Status : uint8_t {
-        New,
-        Visited,
-      };
+      // first pass: runs of each row
 
-      gf::Array2D<Status> status(WorldSize, Status::New);
+      std::vector<std::vector<RegionRun>> rows(WorldSize.h);
 
-      WorldRegions regions = {};
+      pool.parallel_for(rows.size(), [&](std::size_t y) {
+        std::vector<RegionRun>& row = rows[y];
 
-      for (const gf::Vec2I position : state.ground.position_range()) {
-        if (status(position) == Status::Visited) {
-          continue;
+        for (int32_t x = 0; x < WorldSize.w; ++x) {
+          const MapCellBiome biome = state.ground({ x, static_cast<int32_t>(y) }).region;
+
+          if (!row.empty() && row.back().biome == biome && row.back().x + row.back().length == x) {
+            ++row.back().length;
+          } else {
+            row.push_back({ x, 1, biome });
+          }
         }
+      });
 
-        const MapCellBiome region_type = state.ground(position).region;
+      std::vector<uint32_t> row_offsets(rows.size() + 1, 0);
 
-        std::queue<gf::Vec2I> queue;
-        queue.emplace(position);
-        status(position) = Status::Visited;
+      for (std::size_t y = 0; y < rows.size(); ++y) {
+        row_offsets[y + 1] = row_offsets[y] + static_cast<uint32_t>(rows[y].size());
+      }
 
-        WorldRegion region = {};
+      // second pass: merge the runs that touch the runs of the previous row
 
-        while (!queue.empty()) {
-          const gf::Vec2I current = queue.front();
-          queue.pop();
-          assert(status(current) == Status::Visited);
-          region.points.push_back(current);
+      RunUnionFind union_find(row_offsets.back());
 
-          for (const gf::Vec2I neighbor : state.ground.compute_4_neighbors_range(current)) {
-            if (status(neighbor) == Status::Visited) {
-              continue;
-            }
+      auto merge_rows = [&](std::size_t y) {
+        const std::vector<RegionRun>& previous = rows[y - 1];
+        const std::vector<RegionRun>& current = rows[y];
+        std::size_t i = 0;
+        std::size_t j = 0;
 
-            if (state.ground(neighbor).region != region_type) {
-              continue;
-            }
+        while (i < previous.size() && j < current.size()) {
+          const RegionRun& above = previous[i];
+          const RegionRun& below = current[j];
 
-            status(neighbor) = Status::Visited;
-            queue.push(neighbor);
+          if (above.biome == below.biome && above.x < below.x + below.length && below.x < above.x + above.length) {
+            union_find.merge(row_offsets[y - 1] + static_cast<uint32_t>(i), row_offsets[y] + static_cast<uint32_t>(j));
+          }
+
+          if (above.x + above.length < below.x + below.length) {
+            ++i;
+          } else {
+            ++j;
           }
         }
+      };
+
+      const std::size_t band_count = (rows.size() + RegionBandSize - 1) / RegionBandSize;
+
+      // the runs of a band are only touched by the thread of the band
+      pool.parallel_for(band_count, [&](std::size_t band) {
+        const std::size_t first = band * RegionBandSize;
+        const std::size_t last = std::min(first + RegionBandSize, rows.size());
 
-        if (region.points.size() > RegionMinimumSize) {
-          regions(region_type).push_back(std::move(region));
+        for (std::size_t y = first + 1; y < last; ++y) {
+          merge_rows(y);
         }
+      });
+
+      for (std::size_t band = 1; band < band_count; ++band) {
+        merge_rows(band * RegionBandSize);
       }
 
-      // compute region bounds
+      // gather the spans of the regions, in raster order
 
-      auto compute_bounds = [](std::vector<WorldRegion>& regions, std::string_view name) {
+      constexpr uint32_t NoRegion = std::numeric_limits<uint32_t>::max();
+      std::vector<uint32_t> root_regions(row_offsets.back(), NoRegion);
+      std::vector<WorldRegion> all_regions;
+      std::vector<MapCellBiome> all_biomes;
 
-        for (WorldRegion& region : regions) {
-          gf::RectI bounds = gf::RectI::from_center_size(region.points.front(), { 1, 1 });
+      for (std::size_t y = 0; y < rows.size(); ++y) {
+        for (std::size_t i = 0; i < rows[y].size(); ++i) {
+          const RegionRun& run = rows[y][i];
+          const uint32_t root = union_find.find(row_offsets[y] + static_cast<uint32_t>(i));
 
-          for (gf::Vec2I point : region.points) {
-            bounds.extend_to(point);
+          if (root_regions[root] == NoRegion) {
+            root_regions[root] = static_cast<uint32_t>(all_regions.size());
+            all_regions.emplace_back();
+            all_biomes.push_back(run.biome);
           }
 
-          region.bounds = bounds;
+          all_regions[root_regions[root]].add_span({ { run.x, static_cast<int32_t>(y) }, run.length });
+        }
+      }
+
+      WorldRegions regions = {};
+
+      for (std::size_t i = 0; i < all_regions.size(); ++i) {
+        WorldRegion& region = all_regions[i];
+
+        if (region.size() > RegionMinimumSize) {
+          region.compute_index();
+          regions(all_biomes[i]).push_back(std::move(region));
         }
+      }
 
-        std::sort(regions.begin(), regions.end(), [](const WorldRegion& lhs, const WorldRegion& rhs) {
-          return lhs.points.size() > rhs.points.size();
+      auto sort_regions = [](std::vector<WorldRegion>& regions, std::string_view name) {
+        std::stable_sort(regions.begin(), regions.end(), [](const WorldRegion& lhs, const WorldRegion& rhs) {
+          return lhs.size() > rhs.size();
         });
 
-        gf::Log::info("\t{} ({})", name, regions.size());
+        std::size_t span_count = 0;
+
+        for (const WorldRegion& region : regions) {
+          span_count += region.spans.size();
+        }
+
+        gf::Log::info("\t{} ({}, {} spans)", name, regions.size(), span_count);
 
         // for (WorldRegion& region : regions) {
-        //   gf::Log::info("\t\t- Size: {}, Extent: {}x{}, Density: {:g}", region.points.size(), region.bounds.extent.w, region.bounds.extent.h, double(region.points.size()) / double(region.bounds.extent.w * region.bounds.extent.h));
+        //   gf::Log::info("\t\t- Size: {}, Extent: {}x{}, Density: {:g}", region.size(), region.bounds.extent.w, region.bounds.extent.h, double(region.size()) / double(region.bounds.extent.w * region.bounds.extent.h));
         // }
       };
 
-      compute_bounds(regions.prairie_regions, "Prairie");
-      compute_bounds(regions.desert_regions, "Desert");
-      compute_bounds(regions.forest_regions, "Forest");
-      compute_bounds(regions.mountain_regions, "Moutain");
+      sort_regions(regions.prairie_regions, "Prairie");
+      sort_regions(regions.desert_regions, "Desert");
+      sort_regions(regions.forest_regions, "Forest");
+      sort_regions(regions.mountain_regions, "Moutain");
 
       return regions;
     }
@@ -1605,11 +2013,6 @@ namespace fw {
      * Step ... Underground
      */
 
-    struct CaveAccess {
-      gf::Vec2I entrance;
-      gf::Vec2I exit;
-    };
-
     gf::Image compute_image_add_cave_accesses(const gf::Image& original, const MapState& state)
     {
       gf::Image image(original);
@@ -1650,71 +2053,88 @@ namespace fw {
       return image;
     }
 
-    CaveAccess compute_underground_cave_access(MapState& state, const WorldRegion& region, gf::Random* random)
+    // the cliffs of the region that have an accessible neighbor, in one pass over the region
+    std::vector<CaveAccess> compute_cave_access_candidates(const MapState& state, const WorldRegion& region)
     {
-      for (;;) {
-        const std::size_t index = random->compute_uniform_integer(region.points.size());
-        const gf::Vec2I entrance = region.points[index];
+      std::vector<CaveAccess> candidates;
 
-        if (is_on_side(entrance) || state.ground(entrance).decoration != MapCellDecoration::Cliff) {
-          continue;
-        }
+      for (const RegionSpan& span : region.spans) {
+        for (int32_t i = 0; i < span.length; ++i) {
+          const gf::Vec2I entrance = span.start + gf::dirx(i);
 
-        for (const gf::Vec2I exit : state.ground.compute_4_neighbors_range(entrance)) {
-          if (!is_on_side(exit) && state.ground(exit).decoration != MapCellDecoration::Cliff) {
-            return { entrance, exit };
+          if (is_on_side(entrance) || state.ground(entrance).decoration != MapCellDecoration::Cliff) {
+            continue;
+          }
+
+          for (const gf::Vec2I exit : state.ground.compute_4_neighbors_range(entrance)) {
+            if (!is_on_side(exit) && state.ground(exit).decoration != MapCellDecoration::Cliff) {
+              candidates.push_back({ entrance, exit });
+              break;
+            }
           }
         }
       }
 
-      return {{ 0, 0 }, { 0, 0 }};
+      return candidates;
     }
 
-    std::vector<CaveAccess> compute_underground_cave_accesses(MapState& state, const WorldRegion& region, gf::Random* random)
+    std::vector<CaveAccess> compute_underground_cave_accesses(const MapState& state, const WorldRegion& region, gf::Random* random)
     {
-      std::size_t access_count = 1 + region.points.size() / SurfacePerCave;
-      std::vector<CaveAccess> accesses(access_count);
+      const std::size_t access_count = 1 + region.size() / SurfacePerCave;
+      const std::vector<CaveAccess> candidates = compute_cave_access_candidates(state, region);
 
-      std::size_t tries = 0;
+      // the bounds of the region are divided in about one stratum per access, so that the accesses are spread
 
-      // gf::Log::debug("\taccess count: {}", access_count);
+      const gf::Vec2I bounds_size = region.bounds.size();
+      const float stratum_area = static_cast<float>(bounds_size.w) * static_cast<float>(bounds_size.h) / static_cast<float>(access_count);
+      const int32_t stride = std::max(CaveMinDistance, static_cast<int32_t>(std::sqrt(stratum_area)));
+      const gf::Vec2I strata_size = (bounds_size + stride - 1) / stride;
 
-      for (;;) {
+      std::vector<std::vector<CaveAccess>> strata(static_cast<std::size_t>(strata_size.w) * static_cast<std::size_t>(strata_size.h));
 
-        for (std::size_t i = 0; i < access_count; ++i) {
-          accesses[i] = (compute_underground_cave_access(state, region, random));
-        }
+      for (const CaveAccess& candidate : candidates) {
+        const gf::Vec2I stratum = (candidate.entrance - region.bounds.position()) / stride;
+        strata[static_cast<std::size_t>(stratum.x) + static_cast<std::size_t>(stratum.y) * static_cast<std::size_t>(strata_size.w)].push_back(candidate);
+      }
 
-        if (access_count == 1) {
-          return accesses;
-        }
+      std::erase_if(strata, [](const std::vector<CaveAccess>& stratum) { return stratum.empty(); });
+      std::shuffle(strata.begin(), strata.end(), random->engine());
 
-        int32_t min_distance = std::numeric_limits<int32_t>::max();
+      for (std::vector<CaveAccess>& stratum : strata) {
+        std::shuffle(stratum.begin(), stratum.end(), random->engine());
+      }
 
-        for (std::size_t i = 0; i < access_count; ++i) {
-          for (std::size_t j = i + 1; j < access_count; ++j) {
-            const int32_t distance = gf::manhattan_distance(accesses[i].entrance, accesses[j].entrance);
-            min_distance = std::min(min_distance, distance);
-          }
-        }
+      // one access per stratum and per round, a candidate too close to an access is never valid again
 
-        // gf::Log::debug("\tmin distance: {}", min_distance);
+      std::vector<CaveAccess> accesses;
+      std::vector<std::size_t> cursors(strata.size(), 0);
+      bool remaining = true;
 
-        if (min_distance >= CaveMinDistance) {
-          return accesses;
-        }
+      while (accesses.size() < access_count && remaining) {
+        remaining = false;
 
-        ++tries;
+        for (std::size_t i = 0; i < strata.size() && accesses.size() < access_count; ++i) {
+          const std::vector<CaveAccess>& stratum = strata[i];
+          std::size_t& cursor = cursors[i];
 
-        if (tries > MaxCaveAccessTries) {
-          --access_count;
-          accesses.pop_back();
-          tries = 0;
-        }
+          while (cursor < stratum.size()) {
+            const CaveAccess candidate = stratum[cursor++];
+
+            const bool far_enough = std::all_of(accesses.begin(), accesses.end(), [candidate](const CaveAccess& access) {
+              return gf::manhattan_distance(access.entrance, candidate.entrance) >= CaveMinDistance;
+            });
+
+            if (far_enough) {
+              accesses.push_back(candidate);
+              break;
+            }
+          }
 
+          remaining = remaining || cursor < stratum.size();
+        }
       }
 
-      return {};
+      return accesses;
     }
 
 
@@ -1759,36 +2179,63 @@ namespace fw {
       return tunnel;
     }
 
-    void compute_and_dig_tunnel(MapState& state, gf::Vec2I from, gf::Vec2I to, gf::Random* random) {
+    gf::RectI compute_and_dig_tunnel(MapState& state, gf::Vec2I from, gf::Vec2I to, gf::Random* random) {
       constexpr gf::RectI Limits = gf::RectI::from_size(WorldSize).shrink_by(1);
 
       const std::vector<gf::Vec2I> tunnel = compute_tunnel(from, to, random);
+      gf::Vec2I min = from;
+      gf::Vec2I max = from;
 
       for (const gf::Vec2I position : tunnel) {
         state.underground(position).decoration = MapCellDecoration::None;
+        min = { std::min(min.x, position.x), std::min(min.y, position.y) };
+        max = { std::max(max.x, position.x), std::max(max.y, position.y) };
 
         for (const gf::Vec2I neighbor : state.underground.compute_8_neighbors_range(position)) {
-          if (Limits.contains(neighbor)) {
-            MapCell& cell = state.underground(neighbor);
-
-            if (cell.decoration == MapCellDecoration::Rock) {
-              cell.decoration = MapCellDecoration::None;
-            }
+          // read first, so that a chunk of rock is not allocated for nothing
+          if (Limits.contains(neighbor) && std::as_const(state.underground)(neighbor).decoration == MapCellDecoration::Rock) {
+            state.underground(neighbor).decoration = MapCellDecoration::None;
           }
         }
       }
+
+      // with the neighbors
+      return gf::RectI::from_min_max(min - 1, max + 2);
     }
 
-    void compute_underground(MapState& state, const WorldRegions& regions, gf::Random* random)
+    gf::RectI compute_and_dig_cave(MapState& state, const CaveState& cave, gf::Random* random)
     {
+      assert(!cave.accesses.empty());
+      gf::RectI area = gf::RectI::from_center_size(cave.accesses.front().exit, { 3, 3 });
+
+      for (const CaveTunnel& tunnel : cave.tunnels) {
+        const gf::RectI tunnel_area = compute_and_dig_tunnel(state, tunnel.from, tunnel.to, random);
+        const gf::Vec2I min = { std::min(area.min().x, tunnel_area.min().x), std::min(area.min().y, tunnel_area.min().y) };
+        const gf::Vec2I max = { std::max(area.max().x, tunnel_area.max().x), std::max(area.max().y, tunnel_area.max().y) };
+        area = gf::RectI::from_min_max(min, max);
+      }
+
+      return area;
+    }
+
+    void compute_underground(MapState& state, const WorldRegions& regions, const RandomStreams& streams, gf::Random* random, DebugImageSink& debug_images)
+    {
+      // only the plan of the caves, the tunnels are dug later (see dig_cave())
       state.underground = { WorldSize, { MapCellBiome::Underground, MapCellProperty::None, MapCellDecoration::Rock } };
+      state.caves.clear();
 
       for (const WorldRegion& region : regions.mountain_regions) {
-        const std::vector<CaveAccess> accesses = compute_underground_cave_accesses(state, region, random);
+        CaveState cave;
+        cave.accesses = compute_underground_cave_accesses(state, region, random);
 
-        for (const auto [ entrance, exit ] : accesses) {
-          for (const gf::Vec2I cave : state.underground.compute_8_neighbors_range(exit)) {
-            MapCell& cell = state.underground(cave);
+        if (cave.accesses.empty()) {
+          // no cliff with an accessible neighbor
+          continue;
+        }
+
+        for (const auto [ entrance, exit ] : cave.accesses) {
+          for (const gf::Vec2I position : state.underground.compute_8_neighbors_range(exit)) {
+            MapCell& cell = state.underground(position);
             cell.decoration = MapCellDecoration::None;
           }
 
@@ -1796,7 +2243,7 @@ namespace fw {
           state.ground(entrance).decoration = MapCellDecoration::FloorDown;
         }
 
-        const std::size_t access_count = accesses.size();
+        const std::size_t access_count = cave.accesses.size();
 
         auto compute_fake_entrance = [random](gf::Vec2I from) {
           const float radius = random->compute_radius(0.5f * CaveLinkDistance, 0.8f * CaveLinkDistance);
@@ -1807,49 +2254,58 @@ namespace fw {
 
         constexpr gf::RectI Limits = gf::RectI::from_size(WorldSize).shrink_by(5);
 
-        for (const auto [ entrance, exit ] : accesses) {
+        for (const auto [ entrance, exit ] : cave.accesses) {
           const gf::Vec2I fake_entrance = compute_fake_entrance(entrance);
 
           if (Limits.contains(fake_entrance)) {
-            compute_and_dig_tunnel(state, entrance, fake_entrance, random);
+            cave.tunnels.push_back({ entrance, fake_entrance });
           }
         }
 
         if (access_count == 1) {
-          const gf::Vec2I entrance = accesses.front().entrance;
+          const gf::Vec2I entrance = cave.accesses.front().entrance;
 
           const gf::Vec2I fake_entrance = compute_fake_entrance(entrance);
 
           if (Limits.contains(fake_entrance)) {
-            compute_and_dig_tunnel(state, entrance, fake_entrance, random);
+            cave.tunnels.push_back({ entrance, fake_entrance });
           }
-
-          break;
         }
 
         for (std::size_t i = 0; i < access_count; ++i) {
           for (std::size_t j = i + 1; j < access_count; ++j) {
-            const gf::Vec2I entrance0 = accesses[i].entrance;
-            const gf::Vec2I entrance1 = accesses[j].entrance;
+            const gf::Vec2I entrance0 = cave.accesses[i].entrance;
+            const gf::Vec2I entrance1 = cave.accesses[j].entrance;
 
             if (gf::manhattan_distance(entrance0, entrance1) < CaveLinkDistance) {
-              compute_and_dig_tunnel(state, entrance0, entrance1, random);
+              cave.tunnels.push_back({ entrance0, entrance1 });
             }
           }
         }
+
+        state.caves.push_back(std::move(cave));
       }
 
-      if constexpr (Debug) {
-        gf::Image image = compute_basic_image(state.ground, ImageType::Blocks);
+      debug_images.submit("06_accesses.png", [&]() {
+        const gf::Image image = compute_basic_image(state.ground, ImageType::Blocks);
         // image = compute_image_add_towns_and_localities(image, places);
         // image = compute_image_add_railways(image, network);
-        image = compute_image_add_cave_accesses(image, state);
-        image.save_to_file("06_accesses.png");
+        return compute_image_add_cave_accesses(image, state);
+      });
 
-        gf::Image underground_image = compute_basic_image(state.underground, ImageType::Blocks);
-        underground_image = compute_underground_image_add_cave_accesses(underground_image, state);
-        underground_image.save_to_file("06_access_underground.png");
-      }
+      debug_images.submit("06_access_underground.png", [&]() {
+        // all the caves, dug on a copy
+        MapState dug_state;
+        dug_state.underground = state.underground;
+
+        for (const auto [ index, cave ] : gf::enumerate(state.caves)) {
+          gf::Random dig_random = streams.stream(WorldGenerationStep::Underground, index + 1);
+          compute_and_dig_cave(dug_state, cave, &dig_random);
+        }
+
+        const gf::Image underground_image = compute_basic_image(dug_state.underground, ImageType::Blocks);
+        return compute_underground_image_add_cave_accesses(underground_image, dug_state);
+      });
 
     }
 
@@ -1897,13 +2353,13 @@ namespace fw {
 
     gf::Vec2I compute_animal_valid_position(const WorldState& state, const WorldRegion& region, const SeatMap& seat_map, gf::Random* random)
     {
-      const BackgroundMap& background_map = state.map.from_floor(Floor::Ground); // TODO: parameter?
+      const BackgroundMap& background_map = state.map.ground; // TODO: parameter?
 
       for (;;) {
-        const std::size_t position_index = random->compute_uniform_integer(region.points.size());
-        assert(position_index < region.points.size());
+        const std::size_t position_index = random->compute_uniform_integer(region.size());
+        assert(position_index < region.size());
 
-        const gf::Vec2I position = region.points[position_index];
+        const gf::Vec2I position = region.point(position_index);
 
         if (!fw::is_walkable(background_map(position).decoration)) {
           continue;
@@ -1924,7 +2380,7 @@ namespace fw {
       std::size_t overall_count = 0;
 
       for (const WorldRegion& region : regions) {
-        const std::size_t count = region.points.size() / density + 1;
+        const std::size_t count = region.size() / density + 1;
         overall_count += count;
 
         for (std::size_t i = 0; i < count; ++i) {
@@ -2004,61 +2460,107 @@ namespace fw {
 
   }
 
-  WorldState generate_world(gf::Random* random, const WorldData& data, WorldGenerationAnalysis& analysis)
+  WorldState generate_world(uint64_t seed, const WorldData& data, WorldGenerationAnalysis& analysis, std::stop_token token, std::size_t thread_count)
   {
-    gf::Clock clock;
-
-    WorldState state = {};
-    analysis.set_step(WorldGenerationStep::Date);
-    state.current_date = Date::generate_random(random);
-
-    gf::Log::info("Starting generation...");
-    analysis.set_step(WorldGenerationStep::Terrain);
-    const RawWorld primitive_raw = generate_raw(random);
-    gf::Log::info("- raw ({:g}s)", clock.elapsed_time().as_seconds());
-
-    analysis.set_step(WorldGenerationStep::Rivers);
-    const std::vector<River> rivers = generate_rivers(primitive_raw, random);
-    const RawWorld raw = modify_raw_with_rivers(primitive_raw, rivers, random);
-    gf::Log::info("- rivers ({:g}s)", clock.elapsed_time().as_seconds());
-
-    analysis.set_step(WorldGenerationStep::Biomes);
-    state.map = generate_outline(raw, random, rivers);
-    gf::Log::info("- outline ({:g}s)", clock.elapsed_time().as_seconds());
-
-    analysis.set_step(WorldGenerationStep::Moutains);
-    generate_mountains(state.map, random);
-    gf::Log::info("- moutains ({:g}s)", clock.elapsed_time().as_seconds());
-
-    analysis.set_step(WorldGenerationStep::Towns);
-    const WorldPlaces places = generate_places(state.map, random);
-    gf::Log::info("- places ({:g}s)", clock.elapsed_time().as_seconds());
+    using Resource = WorldResource;
 
-    analysis.set_step(WorldGenerationStep::Rails);
-    state.network = generate_network(raw, state.map, places, random);
-    gf::Log::info("- network ({:g}s)", clock.elapsed_time().as_seconds());
-
-    analysis.set_step(WorldGenerationStep::Roads);
-    generate_roads(raw, state.map, state.network, places);
-    gf::Log::info("- roads ({:g}s)", clock.elapsed_time().as_seconds());
+    gf::Clock clock;
+    WorkerPool pool(thread_count);
+    DebugImageSink debug_images(compute_debug_images_directory());
 
-    analysis.set_step(WorldGenerationStep::Buildings);
-    generate_towns(state.map, places, random);
-    generate_localities(state.map, places, random);
-    gf::Log::info("- towns and localities ({:g}s)", clock.elapsed_time().as_seconds());
+    const RandomStreams streams(seed);
 
-    analysis.set_step(WorldGenerationStep::Regions);
-    const WorldRegions regions = compute_regions(state.map);
-    gf::Log::info("- regions ({:g}s)", clock.elapsed_time().as_seconds());
+    WorldState state = {};
+    state.seed = seed;
 
-    analysis.set_step(WorldGenerationStep::Underground);
-    compute_underground(state.map, regions, random);
-    gf::Log::info("- underground ({:g}s)", clock.elapsed_time().as_seconds());
+    RawWorld raw;
+    std::vector<River> rivers;
+    WorldPlaces places;
+    WaterMask water;
+    SummedAreaTable road_cliff_table;
+    WorldRegions regions;
 
-    analysis.set_step(WorldGenerationStep::Hero);
+    gf::Log::info("Starting generation...");
 
-    {
-      ActorState hero = generate_hero(state, data, random);
+    // the steps are in the order of the sequential generation, see WorldGenerationGraph
+    // each step has its own random stream, so only the data make dependencies
+
+    WorldGenerationGraph graph;
+
+    graph.add_step(WorldGenerationStep::Date, Resource::None, Resource::Date, [&]() {
+      gf::Random random = streams.stream(WorldGenerationStep::Date);
+      state.current_date = Date::generate_random(&random);
+    });
+
+    graph.add_step(WorldGenerationStep::Terrain, Resource::None, Resource::Raw, [&]() {
+      gf::Random random = streams.stream(WorldGenerationStep::Terrain);
+      raw = generate_raw(&random, pool);
+      gf::Log::info("- raw ({:g}s)", clock.elapsed_time().as_seconds());
+    });
+
+    graph.add_step(WorldGenerationStep::Rivers, Resource::None, Resource::Raw | Resource::Rivers, [&]() {
+      gf::Random random = streams.stream(WorldGenerationStep::Rivers);
+      rivers = generate_rivers(raw, &random, pool, analysis.statistics());
+      modify_raw_with_rivers(raw, rivers, &random);
+      gf::Log::info("- rivers ({:g}s)", clock.elapsed_time().as_seconds());
+    });
+
+    graph.add_step(WorldGenerationStep::Biomes, Resource::Raw | Resource::Rivers, Resource::GroundBiome | Resource::GroundCells | Resource::Underground | Resource::Buildings, [&]() {
+      state.map = generate_outline(raw, streams, rivers, pool, debug_images);
+      gf::Log::info("- outline ({:g}s)", clock.elapsed_time().as_seconds());
+    });
+
+    graph.add_step(WorldGenerationStep::Moutains, Resource::GroundBiome, Resource::GroundCells, [&]() {
+      generate_mountains(state.map, streams, pool, debug_images);
+      gf::Log::info("- moutains ({:g}s)", clock.elapsed_time().as_seconds());
+    });
+
+    graph.add_step(WorldGenerationStep::Towns, Resource::GroundBiome | Resource::GroundCells, Resource::Places, [&]() {
+      gf::Random random = streams.stream(WorldGenerationStep::Towns);
+      places = generate_places(state.map, compute_open_prairie_table(state.map), &random, pool, debug_images, analysis.statistics());
+      gf::Log::info("- places ({:g}s)", clock.elapsed_time().as_seconds());
+    });
+
+    graph.add_step(WorldGenerationStep::Rails, Resource::Raw | Resource::Places, Resource::GroundCells | Resource::Railway, [&]() {
+      gf::Random random = streams.stream(WorldGenerationStep::Rails);
+
+      // the water does not change after the outline
+      water = WaterMask(state.map.ground, ReducedFactor);
+
+      state.network = generate_network(raw, state.map, compute_cliff_table(state.map), water, places, &random, pool, debug_images);
+      road_cliff_table = compute_cliff_table(state.map); // the railway removed some cliffs
+      gf::Log::info("- network ({:g}s)", clock.elapsed_time().as_seconds());
+    });
+
+    // the roads only need the cells for the debug image
+    const WorldResources road_reads = Resource::Raw | Resource::Places | Resource::Railway | (debug_images.enabled() ? Resource::GroundCells : Resource::None);
+
+    graph.add_step(WorldGenerationStep::Roads, road_reads, Resource::Roads, [&]() {
+      generate_roads(raw, state.map, road_cliff_table, water, state.network, places, pool, debug_images);
+      gf::Log::info("- roads ({:g}s)", clock.elapsed_time().as_seconds());
+    });
+
+    graph.add_step(WorldGenerationStep::Buildings, Resource::Places, Resource::GroundCells | Resource::Buildings, [&]() {
+      gf::Random random = streams.stream(WorldGenerationStep::Buildings);
+      generate_towns(state.map, places, &random);
+      generate_localities(state.map, places, &random);
+      gf::Log::info("- towns and localities ({:g}s)", clock.elapsed_time().as_seconds());
+    });
+
+    graph.add_step(WorldGenerationStep::Regions, Resource::GroundBiome, Resource::Regions, [&]() {
+      regions = compute_regions(state.map, pool);
+      gf::Log::info("- regions ({:g}s)", clock.elapsed_time().as_seconds());
+    });
+
+    graph.add_step(WorldGenerationStep::Underground, Resource::Regions, Resource::GroundCells | Resource::Underground, [&]() {
+      gf::Random random = streams.stream(WorldGenerationStep::Underground);
+      compute_underground(state.map, regions, streams, &random, debug_images);
+      gf::Log::info("- underground ({:g}s)", clock.elapsed_time().as_seconds());
+    });
+
+    graph.add_step(WorldGenerationStep::Hero, Resource::Date | Resource::Railway, Resource::GroundCells | Resource::Actors, [&]() {
+      gf::Random random = streams.stream(WorldGenerationStep::Hero);
+      ActorState hero = generate_hero(state, data, &random);
       compute_hero_fov(hero.location().position, state.map.ground);
 
       assert(state.actors.empty());
@@ -2067,40 +2569,69 @@ namespace fw {
       Date next_turn = state.current_date;
       next_turn.add_seconds(1);
       state.scheduler.queue.push({next_turn, 0});
+    });
 
-    }
+    graph.add_step(WorldGenerationStep::Actors, Resource::Date | Resource::Railway | Resource::Buildings | Resource::Regions | Resource::GroundCells, Resource::Actors, [&]() {
+      gf::Random random = streams.stream(WorldGenerationStep::Actors);
 
-    analysis.set_step(WorldGenerationStep::Actors);
+      // add the trains: at the beginning, one train arriving in each station
 
-    // add the trains: at the beginning, one train arriving in each station
+      for (const StationState& station : state.network.stations) {
+        Date date = state.current_date;
+        date.add_seconds(station.stop_time);
 
-    for (const StationState& station : state.network.stations) {
-      Date date = state.current_date;
-      date.add_seconds(station.stop_time);
+        ActorState train = {};
+        train.data = "Train";
 
-      ActorState train = {};
-      train.data = "Train";
+        TrainComponent component;
+        component.railway_index = station.index;
+        train.component = component;
 
-      TrainComponent component;
-      component.railway_index = station.index;
-      train.component = component;
+        const uint32_t index = static_cast<uint32_t>(state.actors.size());
+        state.actors.push_back(train);
 
-      const uint32_t index = static_cast<uint32_t>(state.actors.size());
-      state.actors.push_back(train);
+        state.scheduler.queue.push({ .date = date, .index = index });
+      }
 
-      state.scheduler.queue.push({ .date = date, .index = index });
-    }
+      SeatMap seat_map = compute_initial_seat_map(state);
+      compute_animals(state, data, regions, seat_map, &random);
 
-    SeatMap seat_map = compute_initial_seat_map(state);
-    compute_animals(state, data, regions, seat_map, random);
+      gf::Log::info("actors: {}", state.actors.size());
 
-    gf::Log::info("actors: {}", state.actors.size());
+      // state.add_message(fmt::format("Hello <style=character>{}</>!", human.name));
 
-    // state.add_message(fmt::format("Hello <style=character>{}</>!", human.name));
+      gf::Log::info("- actors ({:g}s)", clock.elapsed_time().as_seconds());
+    });
 
-    gf::Log::info("- actors ({:g}s)", clock.elapsed_time().as_seconds());
+    graph.run(pool, analysis, std::move(token));
+
+    WorldGenerationStatistics& statistics = analysis.statistics();
+    statistics.railway_length = state.network.railway.size() * ReducedFactor;
+    statistics.road_sections = state.network.road_sections.size();
+    statistics.cave_count = state.map.caves.size();
+
+    for (const CaveState& cave : state.map.caves) {
+      statistics.cave_access_count += cave.accesses.size();
+    }
+
+    statistics.actor_count = state.actors.size();
 
     return state;
   }
 
+  gf::RectI dig_cave(WorldState& state, uint32_t cave_index)
+  {
+    assert(cave_index < state.map.caves.size());
+    CaveState& cave = state.map.caves[cave_index];
+    assert(!cave.dug);
+
+    // the same stream as the debug image of the generation
+    gf::Random random = RandomStreams(state.seed).stream(WorldGenerationStep::Underground, cave_index + 1);
+    const gf::RectI area = compute_and_dig_cave(state.map, cave, &random);
+    // the field of vision of the hero in the cave does not copy any chunk, so it does not race with the binder of the map runtime
+    state.map.underground.own_chunks(area.grow_by(HeroVisionRange));
+    cave.dug = true;
+    return area;
+  }
+
 }
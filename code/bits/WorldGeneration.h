@@ -1,14 +1,26 @@
 #ifndef FW_WORLD_GENERATION_H
 #define FW_WORLD_GENERATION_H
 
-#include <gf2/core/Random.h>
+#include <cstddef>
+#include <cstdint>
+
+#include <stop_token>
+
+#include <gf2/core/Rect.h>
 
 #include "WorldState.h"
 #include "WorldGenerationStep.h"
 
 namespace fw {
 
-  WorldState generate_world(gf::Random* random, const WorldData& data, WorldGenerationAnalysis& analysis);
+  // to increase when the same seed gives a different world
+  constexpr uint16_t GeneratorVersion = 4;
+
+  // the world is incomplete if a stop is requested, 0 thread means one per hardware thread
+  WorldState generate_world(uint64_t seed, const WorldData& data, WorldGenerationAnalysis& analysis, std::stop_token token = {}, std::size_t thread_count = 0);
+
+  // dig the tunnels of a cave that has been planned by generate_world(), returns the area that changed
+  gf::RectI dig_cave(WorldState& state, uint32_t cave_index);
 
 }
 
@@ -0,0 +1,113 @@
+#include "WorldGenerationGraph.h"
+
+#include <cassert>
+
+#include <atomic>
+#include <memory>
+
+#include <gf2/core/Clock.h>
+
+#include "WorkerPool.h"
+
+namespace fw {
+
+  namespace {
+
+    bool depends_on(WorldResources reads, WorldResources writes, WorldResources previous_reads, WorldResources previous_writes)
+    {
+      return static_cast<bool>(previous_writes & (reads | writes)) || static_cast<bool>(previous_reads & writes);
+    }
+
+    // shared by the jobs, the last job may still notify when run() returns
+
+    struct GraphExecution {
+      WorkerPool* pool = nullptr;
+      WorldGenerationAnalysis* analysis = nullptr;
+      std::vector<WorldGenerationStep> steps;
+      std::vector<std::function<void()>> functions;
+      std::vector<std::vector<std::size_t>> successors;
+      std::unique_ptr<std::atomic<std::size_t>[]> remaining;
+      std::atomic<std::size_t> finished = 0;
+      std::stop_token token;
+    };
+
+    void execute_step(const std::shared_ptr<GraphExecution>& execution, std::size_t index)
+    {
+      const WorldGenerationStep step = execution->steps[index];
+
+      // the successors are still counted down so that run() returns
+      if (!execution->token.stop_requested()) {
+        execution->analysis->start_step(step);
+        gf::Clock clock;
+        execution->functions[index]();
+        execution->analysis->finish_step(step, clock.elapsed_time());
+      }
+
+      for (const std::size_t successor : execution->successors[index]) {
+        if (execution->remaining[successor].fetch_sub(1) == 1) {
+          execution->pool->submit([execution, successor]() { execute_step(execution, successor); });
+        }
+      }
+
+      if (execution->finished.fetch_add(1) + 1 == execution->steps.size()) {
+        execution->finished.notify_all();
+      }
+    }
+
+  }
+
+  void WorldGenerationGraph::add_step(WorldGenerationStep step, WorldResources reads, WorldResources writes, std::function<void()> function)
+  {
+    assert(function);
+    m_tasks.push_back({ step, reads, writes, std::move(function) });
+  }
+
+  void WorldGenerationGraph::run(WorkerPool& pool, WorldGenerationAnalysis& analysis, std::stop_token token)
+  {
+    const std::size_t count = m_tasks.size();
+
+    if (count == 0) {
+      return;
+    }
+
+    auto execution = std::make_shared<GraphExecution>();
+    execution->pool = &pool;
+    execution->analysis = &analysis;
+    execution->token = std::move(token);
+    execution->successors.resize(count);
+    execution->remaining = std::make_unique<std::atomic<std::size_t>[]>(count);
+
+    for (std::size_t i = 0; i < count; ++i) {
+      Task& task = m_tasks[i];
+      std::size_t predecessors = 0;
+
+      for (std::size_t j = 0; j < i; ++j) {
+        const Task& previous = m_tasks[j];
+
+        if (depends_on(task.reads, task.writes, previous.reads, previous.writes)) {
+          execution->successors[j].push_back(i);
+          ++predecessors;
+        }
+      }
+
+      execution->remaining[i].store(predecessors);
+      execution->steps.push_back(task.step);
+      execution->functions.push_back(std::move(task.function));
+    }
+
+    m_tasks.clear();
+
+    analysis.start_concurrent_steps();
+
+    for (std::size_t i = 0; i < count; ++i) {
+      if (execution->remaining[i].load() == 0) {
+        pool.submit([execution, i]() { execute_step(execution, i); });
+      }
+    }
+
+    for (std::size_t finished = execution->finished.load(); finished < count; finished = execution->finished.load()) {
+      execution->finished.wait(finished);
+    }
+  }
+
+}
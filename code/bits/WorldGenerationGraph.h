@@ -0,0 +1,71 @@
+#ifndef FW_WORLD_GENERATION_GRAPH_H
+#define FW_WORLD_GENERATION_GRAPH_H
+
+#include <cstdint>
+
+#include <functional>
+#include <stop_token>
+#include <vector>
+
+#include <gf2/core/Flags.h>
+
+#include "WorldGenerationStep.h"
+
+namespace fw {
+  class WorkerPool;
+
+  // the data shared by the steps of the generation
+  enum class WorldResource : uint16_t {
+    None        = 0x0000,
+    Date        = 0x0001,
+    Raw         = 0x0002,
+    Rivers      = 0x0004,
+    GroundBiome = 0x0008, // the biome of the ground cells
+    GroundCells = 0x0010, // the decoration and properties of the ground cells
+    Underground = 0x0020,
+    Places      = 0x0040,
+    Buildings   = 0x0080, // towns and localities
+    Railway     = 0x0100, // railway and stations
+    Roads       = 0x0200,
+    Regions     = 0x0400,
+    Actors      = 0x0800, // actors and scheduler
+  };
+
+  using WorldResources = gf::Flags<WorldResource>;
+
+  constexpr WorldResources operator|(WorldResource lhs, WorldResource rhs)
+  {
+    return WorldResources(lhs) | WorldResources(rhs);
+  }
+
+  /*
+   * The steps of the generation as a graph.
+   *
+   * Each step declares the resources it reads and writes. A step depends on
+   * the previous steps (in the order of insertion) that write a resource it
+   * uses or that read a resource it writes. So the result is the same as
+   * running the steps in sequence, as long as the declarations are right.
+   * The steps must not share a random engine, see RandomStreams.
+   */
+
+  class WorldGenerationGraph {
+  public:
+    void add_step(WorldGenerationStep step, WorldResources reads, WorldResources writes, std::function<void()> function);
+
+    // the steps can use the pool themselves, the steps that have not started when a stop is requested are skipped
+    void run(WorkerPool& pool, WorldGenerationAnalysis& analysis, std::stop_token token = {});
+
+  private:
+    struct Task {
+      WorldGenerationStep step;
+      WorldResources reads;
+      WorldResources writes;
+      std::function<void()> function;
+    };
+
+    std::vector<Task> m_tasks;
+  };
+
+}
+
+#endif // FW_WORLD_GENERATION_GRAPH_H
@@ -2,81 +2,82 @@
 
 #include <cassert>
 
+#include <utility>
+
 #include <gf2/core/Log.h>
 
 namespace fw {
 
-  namespace {
-
-    std::string_view to_string(WorldGenerationStep step)
-    {
-      switch (step) {
-        case WorldGenerationStep::Start:
-          return "Start";
-        case WorldGenerationStep::File:
-          return "File";
-        case WorldGenerationStep::Load:
-          return "Load";
-        case WorldGenerationStep::Date:
-          return "Date";
-        case WorldGenerationStep::Terrain:
-          return "Terrain";
-        case WorldGenerationStep::Rivers:
-          return "Rivers";
-        case WorldGenerationStep::Biomes:
-          return "Biomes";
-        case WorldGenerationStep::Moutains:
-          return "Mountains";
-        case WorldGenerationStep::Towns:
-          return "Towns";
-        case WorldGenerationStep::Rails:
-          return "Rails";
-        case WorldGenerationStep::Roads:
-          return "Roads";
-        case WorldGenerationStep::Buildings:
-          return "Buildings";
-        case WorldGenerationStep::Regions:
-          return "Regions";
-        case WorldGenerationStep::Underground:
-          return "Underground";
-        case WorldGenerationStep::Hero:
-          return "Hero";
-        case WorldGenerationStep::Actors:
-          return "Actors";
-        case WorldGenerationStep::Data:
-          return "Data";
-        case WorldGenerationStep::MapGround:
-          return "MapGround";
-        case WorldGenerationStep::MapUnderground:
-          return "MapUnderground";
-        case WorldGenerationStep::MapRails:
-          return "MapRails";
-        case WorldGenerationStep::MapRoads:
-          return "MapRoads";
-        case WorldGenerationStep::MapTowns:
-          return "MapTowns";
-        case WorldGenerationStep::MapBuildings:
-          return "MapBuildings";
-        case WorldGenerationStep::MapMinimap:
-          return "MapMinimap";
-        case WorldGenerationStep::Network:
-          return "Network";
-        case WorldGenerationStep::FirstTurn:
-          return "FirstTurn";
-        case WorldGenerationStep::End:
-          return "End";
-      }
-
-      return "???";
+  std::string_view to_string(WorldGenerationStep step)
+  {
+    switch (step) {
+      case WorldGenerationStep::Start:
+        return "Start";
+      case WorldGenerationStep::File:
+        return "File";
+      case WorldGenerationStep::Load:
+        return "Load";
+      case WorldGenerationStep::Date:
+        return "Date";
+      case WorldGenerationStep::Terrain:
+        return "Terrain";
+      case WorldGenerationStep::Rivers:
+        return "Rivers";
+      case WorldGenerationStep::Biomes:
+        return "Biomes";
+      case WorldGenerationStep::Moutains:
+        return "Mountains";
+      case WorldGenerationStep::Towns:
+        return "Towns";
+      case WorldGenerationStep::Rails:
+        return "Rails";
+      case WorldGenerationStep::Roads:
+        return "Roads";
+      case WorldGenerationStep::Buildings:
+        return "Buildings";
+      case WorldGenerationStep::Regions:
+        return "Regions";
+      case WorldGenerationStep::Underground:
+        return "Underground";
+      case WorldGenerationStep::Hero:
+        return "Hero";
+      case WorldGenerationStep::Actors:
+        return "Actors";
+      case WorldGenerationStep::Data:
+        return "Data";
+      case WorldGenerationStep::MapGround:
+        return "MapGround";
+      case WorldGenerationStep::MapUnderground:
+        return "MapUnderground";
+      case WorldGenerationStep::MapRails:
+        return "MapRails";
+      case WorldGenerationStep::MapRoads:
+        return "MapRoads";
+      case WorldGenerationStep::MapTowns:
+        return "MapTowns";
+      case WorldGenerationStep::MapBuildings:
+        return "MapBuildings";
+      case WorldGenerationStep::MapMinimap:
+        return "MapMinimap";
+      case WorldGenerationStep::MapChunks:
+        return "MapChunks";
+      case WorldGenerationStep::Network:
+        return "Network";
+      case WorldGenerationStep::FirstTurn:
+        return "FirstTurn";
+      case WorldGenerationStep::End:
+        return "End";
     }
 
+    return "???";
   }
 
   void WorldGenerationAnalysis::set_step(WorldGenerationStep step)
   {
-    const WorldGenerationStep previous = m_current_step.exchange(step);
+    const WorldGenerationStep previous = std::exchange(m_clock_step, step);
+    m_current_step.store(step);
 
-    if (step == WorldGenerationStep::Start) {
+    if (step == WorldGenerationStep::Start || previous == WorldGenerationStep::End) {
       m_current_clock.restart();
     } else {
       std::size_t index = static_cast<std::size_t>(previous);
@@ -90,6 +91,38 @@ namespace fw {
     return m_current_step.load();
   }
 
+  void WorldGenerationAnalysis::start_concurrent_steps()
+  {
+    // the current step ends here and the next call to set_step() does not measure anything
+    const WorldGenerationStep previous = std::exchange(m_clock_step, WorldGenerationStep::End);
+
+    if (previous != WorldGenerationStep::End) {
+      std::size_t index = static_cast<std::size_t>(previous);
+      assert(index < m_step_times.size());
+      m_step_times[index] = m_current_clock.restart();
+    }
+  }
+
+  void WorldGenerationAnalysis::start_step(WorldGenerationStep step)
+  {
+    m_current_step.store(step);
+  }
+
+  void WorldGenerationAnalysis::finish_step(WorldGenerationStep step, gf::Time time)
+  {
+    // each step runs once, so the steps do not write at the same place
+    std::size_t index = static_cast<std::size_t>(step);
+    assert(index < m_step_times.size());
+    m_step_times[index] = time;
+  }
+
+  gf::Time WorldGenerationAnalysis::step_time(WorldGenerationStep step) const
+  {
+    std::size_t index = static_cast<std::size_t>(step);
+    assert(index < m_step_times.size());
+    return m_step_times[index];
+  }
+
   void WorldGenerationAnalysis::print_analysis() const
   {
     for (std::size_t i = 0; i < m_step_times.size(); ++i) {
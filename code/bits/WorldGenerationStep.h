@@ -1,10 +1,12 @@
 #ifndef FW_WORLD_GENERATION_STEP_H
 #define FW_WORLD_GENERATION_STEP_H
 
+#include <cstddef>
 #include <cstdint>
 
 #include <array>
 #include <atomic>
+#include <string_view>
 
 #include <gf2/core/Clock.h>
 #include <gf2/core/Time.h>
@@ -39,25 +41,61 @@ namespace fw {
     MapTowns,
     MapBuildings,
     MapMinimap,
+    MapChunks,
     Network,
 
     FirstTurn,
     End,
   };
 
+  std::string_view to_string(WorldGenerationStep step);
+
+  // the quality of the generation, to find the seeds that take too many tries
+  struct WorldGenerationStatistics {
+    int river_rounds = 0;
+    std::size_t river_length = 0;
+    int town_rounds = 0;
+    int locality_rounds = 0;
+    std::size_t railway_length = 0;
+    std::size_t road_sections = 0;
+    std::size_t cave_count = 0;
+    std::size_t cave_access_count = 0;
+    std::size_t actor_count = 0;
+  };
+
   class WorldGenerationAnalysis {
   public:
 
     void set_step(WorldGenerationStep step);
     WorldGenerationStep step() const;
 
+    // for the steps running concurrently, the time of each step is measured by the caller
+    void start_concurrent_steps();
+    void start_step(WorldGenerationStep step);
+    void finish_step(WorldGenerationStep step, gf::Time time);
+
+    gf::Time step_time(WorldGenerationStep step) const;
+
+    // each field is written by one step only
+    WorldGenerationStatistics& statistics()
+    {
+      return m_statistics;
+    }
+
+    const WorldGenerationStatistics& statistics() const
+    {
+      return m_statistics;
+    }
+
     void print_analysis() const;
 
   private:
     static constexpr std::size_t StepCount = static_cast<std::size_t>(WorldGenerationStep::End);
     gf::Clock m_current_clock;
+    WorldGenerationStep m_clock_step = WorldGenerationStep::Start; // the step measured by the clock, End if none
     std::atomic<WorldGenerationStep> m_current_step = WorldGenerationStep::Start;
     std::array<gf::Time, StepCount> m_step_times = {};
+    WorldGenerationStatistics m_statistics;
   };
 
 
@@ -3,6 +3,9 @@
 #include <cassert>
 #include <cstdint>
 
+#include <gf2/core/Clock.h>
+#include <gf2/core/Log.h>
+
 #include "Action.h"
 #include "ActorState.h"
 #include "Behavior.h"
@@ -10,6 +13,7 @@
 #include "MapRuntime.h"
 #include "MapState.h"
 #include "SchedulerState.h"
+#include "WorldGeneration.h"
 #include "WorldGenerationStep.h"
 
 namespace fw {
@@ -25,11 +29,13 @@ namespace fw {
   {
   }
 
-  void WorldModel::bind(WorldGenerationAnalysis& analysis)
+  void WorldModel::bind(WorldGenerationAnalysis& analysis, std::size_t thread_count)
   {
     analysis.set_step(WorldGenerationStep::Data);
     state.bind(data);
-    runtime.bind(data, state, m_random, analysis);
+    // the chunks may be shared with the world cache, they must not be copied while the map runtime binds
+    state.map.underground.own_allocated_chunks();
+    runtime.bind(data, state, analysis, thread_count);
   }
 
   void WorldModel::update(gf::Time time)
@@ -115,6 +121,22 @@ namespace fw {
     return true;
   }
 
+  void WorldModel::prepare_cave(gf::Vec2I entrance)
+  {
+    const uint32_t cave_index = state.map.find_cave(entrance);
+
+    if (cave_index == NoIndex || state.map.caves[cave_index].dug) {
+      return;
+    }
+
+    // only the caves of this region, the binder must not read the underground while it is dug
+    gf::Clock clock;
+    runtime.map.stop_binding();
+    const gf::RectI area = dig_cave(state, cave_index);
+    runtime.map.bind_cave(state, area);
+    gf::Log::debug("Cave {} dug in {:g}s", cave_index, clock.elapsed_time().as_seconds());
+  }
+
   void WorldModel::update_date()
   {
     state.current_date = state.scheduler.queue.top().date;
@@ -179,8 +201,18 @@ namespace fw {
     if (runtime.hero.action.type() == ActionType::Move) {
       if (result == ActionResult::Success) {
         const Location new_location = hero.location();
-        BackgroundMap& state_map = state.map.from_floor(new_location.floor);
-        const std::vector<gf::Vec2I> explored = compute_hero_fov(new_location.position, state_map);
+        // should not happen after dig_cave(), but the field of vision must not copy the chunks that the binder reads
+        const bool shares_chunks = new_location.floor == Floor::Underground && hero_fov_shares_chunks(new_location.position, state.map.underground);
+
+        if (shares_chunks) {
+          runtime.map.stop_binding();
+        }
+
+        const std::vector<gf::Vec2I> explored = compute_hero_fov(new_location, state.map);
+
+        if (shares_chunks) {
+          runtime.map.resume_binding();
+        }
 
         // update minimap thanks to field of view
         FloorMap& runtime_map = runtime.map.from_floor(new_location.floor);
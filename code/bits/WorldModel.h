@@ -20,7 +20,8 @@ namespace fw {
     WorldState state;
     WorldRuntime runtime;
 
-    void bind(WorldGenerationAnalysis& analysis);
+    // thread_count: 0 means one thread per hardware thread
+    void bind(WorldGenerationAnalysis& analysis, std::size_t thread_count = 0);
 
     void update(gf::Time time) override;
     bool is_running() const { return m_phase == ModelPhase::Running; }
@@ -29,6 +30,9 @@ namespace fw {
 
     bool is_walkable(Floor floor, gf::Vec2I position) const;
 
+    // the caves of the entrance are dug the first time an actor goes down
+    void prepare_cave(gf::Vec2I entrance);
+
     void update_current_task_in_queue(uint16_t seconds);
 
 
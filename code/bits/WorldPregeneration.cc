@@ -0,0 +1,100 @@
+#include "WorldPregeneration.h"
+
+#include <cassert>
+
+#include <chrono>
+
+#include <gf2/core/Clock.h>
+#include <gf2/core/Log.h>
+
+#include "WorldCache.h"
+#include "WorldData.h"
+#include "WorldGeneration.h"
+#include "WorldGenerationStep.h"
+
+namespace fw {
+
+  WorldPregeneration::WorldPregeneration(WorldCache* cache, std::filesystem::path datafile)
+  : m_cache(cache)
+  , m_datafile(std::move(datafile))
+  {
+  }
+
+  WorldPregeneration::~WorldPregeneration()
+  {
+    // the futures wait for the threads when they are destroyed
+    m_stop.request_stop();
+  }
+
+  void WorldPregeneration::start(uint64_t seed)
+  {
+    assert(!pending());
+    m_key = WorldCache::compute_key(seed, m_datafile);
+    m_stop = std::stop_source();
+    m_analysis = std::make_shared<WorldGenerationAnalysis>();
+
+    m_world = std::async(std::launch::async, [cache = m_cache, datafile = m_datafile, key = m_key, seed, token = m_stop.get_token(), analysis = m_analysis]() {
+      PregeneratedWorld world;
+      analysis->set_step(WorldGenerationStep::Load);
+
+      if (cache->load(key, world.state)) {
+        world.cached = true;
+        return world;
+      }
+
+      gf::Clock clock;
+
+      WorldData data;
+      data.load_from_file(datafile);
+
+      world.state = generate_world(seed, data, *analysis, token);
+
+      if (!token.stop_requested()) {
+        gf::Log::info("World pregenerated in {:g}s", clock.elapsed_time().as_seconds());
+      }
+
+      return world;
+    });
+  }
+
+  WorldState WorldPregeneration::take(WorldGenerationAnalysis& analysis)
+  {
+    assert(pending());
+
+    while (m_world.wait_for(std::chrono::milliseconds(50)) != std::future_status::ready) {
+      // not measured, the whole wait is measured by the current step of the analysis
+      analysis.start_step(m_analysis->step());
+    }
+
+    PregeneratedWorld world = m_world.get();
+    m_analysis.reset();
+
+    if (!world.cached) {
+      m_async_cache = m_cache->store_copy(m_key, world.state);
+    }
+
+    return std::move(world.state);
+  }
+
+  void WorldPregeneration::release()
+  {
+    assert(pending());
+    m_analysis.reset();
+
+    if (m_world.wait_for(std::chrono::seconds::zero()) != std::future_status::ready) {
+      // the generation would compete with the game for the threads, the unfinished world is not worth it
+      m_stop.request_stop();
+      m_async_cache = std::async(std::launch::async, [world = std::move(m_world)]() mutable {
+        world.wait();
+      });
+      return;
+    }
+
+    PregeneratedWorld world = m_world.get();
+
+    if (!world.cached) {
+      m_async_cache = m_cache->store_copy(m_key, std::move(world.state));
+    }
+  }
+
+}
@@ -0,0 +1,65 @@
+#ifndef FW_WORLD_PREGENERATION_H
+#define FW_WORLD_PREGENERATION_H
+
+#include <cstdint>
+
+#include <filesystem>
+#include <future>
+#include <memory>
+#include <stop_token>
+
+#include "WorldGenerationStep.h"
+#include "WorldState.h"
+
+namespace fw {
+  class WorldCache;
+
+  /*
+   * A world generated in the background before it is asked for.
+   *
+   * The generation starts while the title and the menu are shown. If the
+   * player starts a new adventure, the world is taken from here. Otherwise,
+   * the world is released: it is stored in the cache if it is ready, and the
+   * generation is stopped if it is not.
+   */
+
+  class WorldPregeneration {
+  public:
+    WorldPregeneration(WorldCache* cache, std::filesystem::path datafile);
+    WorldPregeneration(const WorldPregeneration&) = delete;
+    WorldPregeneration(WorldPregeneration&&) = delete;
+    ~WorldPregeneration();
+
+    WorldPregeneration& operator=(const WorldPregeneration&) = delete;
+    WorldPregeneration& operator=(WorldPregeneration&&) = delete;
+
+    void start(uint64_t seed);
+
+    // true if a world has been started and neither taken nor released
+    bool pending() const
+    {
+      return m_world.valid();
+    }
+
+    // waits for the world, the steps of the generation are shown in the analysis
+    WorldState take(WorldGenerationAnalysis& analysis);
+    void release();
+
+  private:
+    struct PregeneratedWorld {
+      WorldState state;
+      bool cached = false;
+    };
+
+    WorldCache* m_cache = nullptr;
+    std::filesystem::path m_datafile;
+    uint64_t m_key = 0;
+    std::stop_source m_stop; // one for each generation
+    std::shared_ptr<WorldGenerationAnalysis> m_analysis;
+    std::future<PregeneratedWorld> m_world;
+    std::future<void> m_async_cache;
+  };
+
+}
+
+#endif // FW_WORLD_PREGENERATION_H
@@ -40,10 +40,10 @@ namespace fw {
     }
   }
 
-  void WorldRuntime::bind([[maybe_unused]] const WorldData& data, const WorldState& state, gf::Random* random, WorldGenerationAnalysis& analysis)
+  void WorldRuntime::bind([[maybe_unused]] const WorldData& data, const WorldState& state, WorldGenerationAnalysis& analysis, std::size_t thread_count)
   {
     view_center = state.hero().location().position;
-    map.bind(state, random, analysis);
+    map.bind(state, analysis, thread_count);
 
     analysis.set_step(WorldGenerationStep::Network);
     bind_network(state);
@@ -3,8 +3,6 @@
 
 #include <vector>
 
-#include <gf2/core/Random.h>
-
 #include "Date.h"
 #include "HeroRuntime.h"
 #include "MapRuntime.h"
@@ -29,7 +27,7 @@ namespace fw {
 
     void set_reverse_train(uint32_t railway_index, uint32_t train_index);
 
-    void bind(const WorldData& data, const WorldState& state, gf::Random* random, WorldGenerationAnalysis& analysis);
+    void bind(const WorldData& data, const WorldState& state, WorldGenerationAnalysis& analysis, std::size_t thread_count = 0);
 
     void bind_network(const WorldState& state);
     void bind_reverse(const WorldState& state);
@@ -20,9 +20,10 @@
 namespace fw {
   struct WorldData;
 
-  constexpr std::uint16_t StateVersion = 1;
+  constexpr std::uint16_t StateVersion = 5;
 
   struct WorldState {
+    uint64_t seed = 0;
     Date current_date;
 
     MapState map;
@@ -57,7 +58,7 @@ namespace fw {
   template<typename Archive>
   Archive& operator|(Archive& ar, gf::MaybeConst<WorldState, Archive>& state)
   {
-    return ar | state.current_date | state.map | state.network | state.actors | state.debt | state.scheduler | state.journal;
+    return ar | state.seed | state.current_date | state.map | state.network | state.actors | state.debt | state.scheduler | state.journal;
   }
 
 }
@@ -1,41 +1,387 @@
+#include <cstdint>
+#include <cstdlib>
+
+#include <algorithm>
+#include <charconv>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <ostream>
+#include <print>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include <nlohmann/json.hpp>
+
 #include <gf2/core/Clock.h>
 #include <gf2/core/Log.h>
 #include <gf2/core/Random.h>
+#include <gf2/core/Range.h>
 
-#include "bits/Times.h"
+#include "bits/RandomStreams.h"
 #include "bits/WorldGeneration.h"
 #include "bits/WorldGenerationStep.h"
 #include "bits/WorldModel.h"
 
 #include "config.h"
 
-int main() {
+namespace {
+
+  /*
+   * Options
+   */
+
+  enum class Format {
+    Csv,
+    Json,
+  };
+
+  struct Options {
+    std::optional<uint64_t> first_seed;
+    uint64_t seed_count = 1;
+    std::size_t thread_count = 0;
+    Format format = Format::Csv;
+    std::filesystem::path output;
+  };
+
+  void print_usage()
+  {
+    std::println(std::cerr, "Usage: world-generation [--seeds FIRST[:COUNT]] [--threads N] [--format csv|json] [--output FILE]");
+  }
+
+  template<typename T>
+  std::optional<T> parse_integer(std::string_view value)
+  {
+    T result = 0;
+
+    if (auto [ end, error ] = std::from_chars(value.data(), value.data() + value.size(), result); error == std::errc() && end == value.data() + value.size()) {
+      return result;
+    }
+
+    return std::nullopt;
+  }
+
+  std::optional<Options> parse_options(int argc, char* argv[])
+  {
+    Options options;
+
+    for (int i = 1; i < argc; ++i) {
+      const std::string_view argument = argv[i];
+
+      if (i + 1 >= argc) {
+        return std::nullopt;
+      }
+
+      const std::string_view value = argv[++i];
+
+      if (argument == "--seeds") {
+        const std::size_t separator = value.find(':');
+        options.first_seed = parse_integer<uint64_t>(value.substr(0, separator));
+
+        if (separator != std::string_view::npos) {
+          const std::optional<uint64_t> count = parse_integer<uint64_t>(value.substr(separator + 1));
+
+          if (!count || *count == 0) {
+            return std::nullopt;
+          }
+
+          options.seed_count = *count;
+        }
+
+        if (!options.first_seed) {
+          return std::nullopt;
+        }
+      } else if (argument == "--threads") {
+        const std::optional<std::size_t> thread_count = parse_integer<std::size_t>(value);
+
+        if (!thread_count) {
+          return std::nullopt;
+        }
+
+        options.thread_count = *thread_count;
+      } else if (argument == "--format") {
+        if (value == "csv") {
+          options.format = Format::Csv;
+        } else if (value == "json") {
+          options.format = Format::Json;
+        } else {
+          return std::nullopt;
+        }
+      } else if (argument == "--output") {
+        options.output = value;
+      } else {
+        return std::nullopt;
+      }
+    }
+
+    return options;
+  }
+
+  /*
+   * Measures
+   */
+
+  // in KiB, the high-water mark of the whole process
+  std::size_t compute_peak_rss()
+  {
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters = {};
+
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+      return counters.PeakWorkingSetSize / 1024;
+    }
+
+    return 0;
+#else
+    rusage usage = {};
+
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+      return static_cast<std::size_t>(usage.ru_maxrss); // KiB on Linux
+    }
+
+    return 0;
+#endif
+  }
+
+  constexpr fw::WorldGenerationStep FirstMeasuredStep = fw::WorldGenerationStep::Date;
+  constexpr fw::WorldGenerationStep LastMeasuredStep = fw::WorldGenerationStep::MapChunks;
+
+  std::vector<fw::WorldGenerationStep> compute_measured_steps()
+  {
+    std::vector<fw::WorldGenerationStep> steps;
+
+    for (auto step = static_cast<std::size_t>(FirstMeasuredStep); step <= static_cast<std::size_t>(LastMeasuredStep); ++step) {
+      steps.push_back(static_cast<fw::WorldGenerationStep>(step));
+    }
+
+    return steps;
+  }
+
+  struct WorldMeasure {
+    uint64_t seed = 0;
+    std::vector<double> step_times; // in ms, same order as the measured steps
+    double total_time = 0.0; // in ms
+    fw::WorldGenerationStatistics statistics;
+  };
+
+  struct Summary {
+    double min = 0.0;
+    double median = 0.0;
+    double p95 = 0.0;
+    double max = 0.0;
+  };
+
+  Summary compute_summary(std::vector<double> values)
+  {
+    if (values.empty()) {
+      return {};
+    }
+
+    std::sort(values.begin(), values.end());
+
+    // nearest rank
+    auto percentile = [&values](std::size_t percent) {
+      const std::size_t rank = (percent * values.size() + 99) / 100;
+      return values[std::max<std::size_t>(rank, 1) - 1];
+    };
+
+    return { values.front(), percentile(50), percentile(95), values.back() };
+  }
+
+  /*
+   * Reports
+   */
+
+  void write_csv(std::ostream& output, const std::vector<fw::WorldGenerationStep>& steps, const std::vector<WorldMeasure>& measures)
+  {
+    std::print(output, "seed");
+
+    for (const fw::WorldGenerationStep step : steps) {
+      std::print(output, ",{}", fw::to_string(step));
+    }
+
+    std::println(output, ",Total,RiverRounds,RiverLength,TownRounds,LocalityRounds,RailwayLength,RoadSections,Caves,CaveAccesses,Actors");
+
+    for (const WorldMeasure& measure : measures) {
+      std::print(output, "{}", measure.seed);
+
+      for (const double time : measure.step_times) {
+        std::print(output, ",{:.3f}", time);
+      }
+
+      const fw::WorldGenerationStatistics& statistics = measure.statistics;
+      std::println(output, ",{:.3f},{},{},{},{},{},{},{},{},{}", measure.total_time, statistics.river_rounds, statistics.river_length, statistics.town_rounds, statistics.locality_rounds, statistics.railway_length, statistics.road_sections, statistics.cave_count, statistics.cave_access_count, statistics.actor_count);
+    }
+
+    std::println(output);
+    std::println(output, "step,min,median,p95,max");
+
+    auto print_summary = [&output](std::string_view name, const Summary& summary) {
+      std::println(output, "{},{:.3f},{:.3f},{:.3f},{:.3f}", name, summary.min, summary.median, summary.p95, summary.max);
+    };
+
+    for (const auto [ index, step ] : gf::enumerate(steps)) {
+      std::vector<double> times;
+
+      for (const WorldMeasure& measure : measures) {
+        times.push_back(measure.step_times[index]);
+      }
+
+      print_summary(fw::to_string(step), compute_summary(std::move(times)));
+    }
+
+    std::vector<double> total_times;
+
+    for (const WorldMeasure& measure : measures) {
+      total_times.push_back(measure.total_time);
+    }
+
+    print_summary("Total", compute_summary(std::move(total_times)));
+
+    // the high-water mark of the whole run, not of a world
+    std::println(output);
+    std::println(output, "PeakRSS");
+    std::println(output, "{}", compute_peak_rss());
+  }
+
+  void write_json(std::ostream& output, const std::vector<fw::WorldGenerationStep>& steps, const std::vector<WorldMeasure>& measures)
+  {
+    nlohmann::json json;
+    json["worlds"] = nlohmann::json::array();
+
+    for (const WorldMeasure& measure : measures) {
+      nlohmann::json world;
+      world["seed"] = measure.seed;
+
+      for (const auto [ index, step ] : gf::enumerate(steps)) {
+        world["steps"][std::string(fw::to_string(step))] = measure.step_times[index];
+      }
+
+      world["total"] = measure.total_time;
+
+      const fw::WorldGenerationStatistics& statistics = measure.statistics;
+      world["statistics"] = {
+        { "river_rounds", statistics.river_rounds },
+        { "river_length", statistics.river_length },
+        { "town_rounds", statistics.town_rounds },
+        { "locality_rounds", statistics.locality_rounds },
+        { "railway_length", statistics.railway_length },
+        { "road_sections", statistics.road_sections },
+        { "caves", statistics.cave_count },
+        { "cave_accesses", statistics.cave_access_count },
+        { "actors", statistics.actor_count },
+      };
+
+      json["worlds"].push_back(std::move(world));
+    }
+
+    auto to_json = [](const Summary& summary) {
+      return nlohmann::json{ { "min", summary.min }, { "median", summary.median }, { "p95", summary.p95 }, { "max", summary.max } };
+    };
+
+    for (const auto [ index, step ] : gf::enumerate(steps)) {
+      std::vector<double> times;
+
+      for (const WorldMeasure& measure : measures) {
+        times.push_back(measure.step_times[index]);
+      }
+
+      json["summary"][std::string(fw::to_string(step))] = to_json(compute_summary(std::move(times)));
+    }
+
+    std::vector<double> total_times;
+
+    for (const WorldMeasure& measure : measures) {
+      total_times.push_back(measure.total_time);
+    }
+
+    json["summary"]["Total"] = to_json(compute_summary(std::move(total_times)));
+    // the high-water mark of the whole run, not of a world
+    json["peak_rss"] = compute_peak_rss();
+
+    output << json.dump(2) << '\n';
+  }
+
+}
+
+int main(int argc, char* argv[]) {
+  const std::optional<Options> maybe_options = parse_options(argc, argv);
+
+  if (!maybe_options) {
+    print_usage();
+    return EXIT_FAILURE;
+  }
+
+  const Options& options = *maybe_options;
   const std::filesystem::path data_directory = fw::FarWestDataDirectory;
 
   gf::Random random;
-  fw::WorldGenerationAnalysis analysis;
-
   fw::WorldModel model(&random);
 
-  analysis.set_step(fw::WorldGenerationStep::File);
-  model.data.load_from_file(data_directory / "data.json");
-  model.state = fw::generate_world(&random, model.data, analysis);
-  model.bind(analysis);
-  analysis.print_analysis();
+  const std::filesystem::path datafile = data_directory / "data.json";
+  model.data.load_from_file(datafile);
+
+  // no cache, every world is generated
+  const uint64_t first_seed = options.first_seed ? *options.first_seed : fw::generate_seed(&random);
+  const std::vector<fw::WorldGenerationStep> steps = compute_measured_steps();
+  std::vector<WorldMeasure> measures;
+
+  for (uint64_t i = 0; i < options.seed_count; ++i) {
+    const uint64_t seed = first_seed + i;
+    gf::Log::info("World {}/{}, seed: {}", i + 1, options.seed_count, seed);
 
-  return 0;
+    fw::WorldGenerationAnalysis analysis;
+    gf::Clock clock;
 
-  gf::Clock clock;
+    analysis.set_step(fw::WorldGenerationStep::Start);
+    model.state = fw::generate_world(seed, model.data, analysis, {}, options.thread_count);
+    model.bind(analysis, options.thread_count);
+    analysis.set_step(fw::WorldGenerationStep::End);
+    // the rest of the map is not measured
+    model.runtime.map.stop_binding();
 
-  for (;;) {
-    if (model.is_running()) {
-      gf::Log::debug("Step: {} µs", clock.restart().as_microseconds());
-    } else {
-      gf::Log::debug("Cooldown");
+    WorldMeasure measure;
+    measure.seed = seed;
+    measure.total_time = clock.elapsed_time().as_seconds() * 1000.0;
+
+    for (const fw::WorldGenerationStep step : steps) {
+      measure.step_times.push_back(analysis.step_time(step).as_seconds() * 1000.0);
     }
 
-    model.runtime.hero.action = fw::make_action<fw::IdleAction>(fw::IdleTime);
-    model.update(gf::seconds(1.0f / 60.0f));
+    measure.statistics = analysis.statistics();
+    measures.push_back(std::move(measure));
+  }
+
+  std::ofstream file;
+
+  if (!options.output.empty()) {
+    file.open(options.output);
+
+    if (!file) {
+      gf::Log::error("Could not open '{}'", options.output.string());
+      return EXIT_FAILURE;
+    }
+  }
+
+  std::ostream& output = options.output.empty() ? std::cout : file;
+
+  switch (options.format) {
+    case Format::Csv:
+      write_csv(output, steps, measures);
+      break;
+    case Format::Json:
+      write_json(output, steps, measures);
+      break;
   }
 
+  return EXIT_SUCCESS;
 }